@@ -0,0 +1,136 @@
+#ifndef _BATCH_
+#define _BATCH_
+
+#include <cstdint>
+
+#include "player.hxx"
+
+// Compile the kernel for several instruction sets and pick one at load
+// time from the running CPU. The load-time resolver runs before the
+// ThreadSanitizer runtime is set up, so TSan builds get a single version.
+#if defined(__SANITIZE_THREAD__)
+#define BATCH_TSAN
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define BATCH_TSAN
+#endif
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__INTEL_COMPILER) \
+   && !defined(BATCH_TSAN)
+#define BATCH_TARGETS __attribute__((target_clones("avx512f","avx2","default")))
+#else
+#define BATCH_TARGETS
+#endif
+
+// Plays Batch::lanes independent games side by side. Genomes, histories
+// and tallies are kept one array per field with one slot per game, and
+// every round is the same branch-free update for each slot, so the
+// compiler turns the lane loops into vector code. Lanes are switched on
+// and off with all-ones/all-zero masks rather than multiplies.
+//
+// Like Player::play, a lane stops as soon as its history repeats, and the
+// batch stops once every lane has. The four outcome counts of a lane are
+// packed into one word, and the word is saved each round together with
+// the history, so the cycle and the leftover partial lap are read back
+// from those saves instead of being played again.
+struct Batch
+{
+   static constexpr size_t lanes = 64;
+   static constexpr size_t states = 64;
+
+   uint64_t genome_a[lanes], genome_b[lanes], history[lanes];
+   Player::Match result[lanes];
+
+   BATCH_TARGETS
+   void play(size_t rounds)
+   {
+      // counts[r][l]: lane l's outcomes before round r; entered[r][l]: its history then
+      uint64_t counts[states + 2][lanes], entered[states + 1][lanes];
+      uint64_t h[lanes], seen[lanes], on[lanes], total[lanes];
+      for (size_t l = 0; l < lanes; ++l)
+      {
+         h[l] = history[l] & (states - 1);
+         seen[l] = total[l] = counts[0][l] = 0;
+         on[l] = ~uint64_t(0);
+      }
+
+      // a walk over 64 histories repeats one by round 64
+      size_t played = 0;
+      while (played < rounds)
+      {
+         uint64_t busy = 0;
+         for (size_t l = 0; l < lanes; ++l)
+         {
+            const uint64_t was = h[l];
+            on[l] &= ((seen[l] >> was) & 1) - 1;
+            seen[l] |= (on[l] & 1) << was;
+            step(genome_a[l], genome_b[l], h[l], on[l], total[l]);
+            entered[played][l] = was;
+            counts[played + 1][l] = total[l];
+            busy |= on[l];
+         }
+         if (!busy)
+            break;
+         ++played;
+      }
+
+      // round at which each lane first entered its current history
+      uint64_t first[lanes];
+      for (size_t l = 0; l < lanes; ++l)
+         first[l] = states;
+      for (size_t r = 0; r < played; ++r)
+         for (size_t l = 0; l < lanes; ++l)
+            first[l] = (entered[r][l] == h[l] && r < first[l]) ? r : first[l];
+
+      for (size_t l = 0; l < lanes; ++l)
+      {
+         uint64_t n[4];
+         for (int o = 0; o < 4; ++o)
+            n[o] = field(total[l], o);
+
+         const uint64_t done = n[0] + n[1] + n[2] + n[3];
+         if (done < rounds)
+         {
+            // rounds [first, done) are the cycle; the rest of the game repeats it
+            const uint64_t start = first[l];
+            const uint64_t period = done - start;
+            const uint64_t laps = (rounds - done) / period;
+            const uint64_t tail = (rounds - done) % period;
+            const uint64_t lap = total[l] - counts[start][l];
+            const uint64_t part = counts[start + tail][l] - counts[start][l];
+            for (int o = 0; o < 4; ++o)
+               n[o] += laps * field(lap, o) + field(part, o);
+         }
+
+         // Player::score: CC 1, CD 20, DC 0, DD 10
+         result[l].score_a = n[0] + 20 * n[1] + 10 * n[3];
+         result[l].score_b = n[0] + 20 * n[2] + 10 * n[3];
+         result[l].coop = n[0];
+         result[l].defect = n[3];
+         result[l].mixed = rounds - n[0] - n[3];
+      }
+   }
+
+   private:
+      // Outcome counts are 16-bit fields of one word, indexed by
+      // 2*a + b: CC, CD, DC, DD (1 is a defection).
+      static inline uint64_t field(uint64_t counts, int o)
+      {
+         return (counts >> (16 * o)) & 0xffff;
+      }
+
+      // One round of Player::compete; "on" is an all-ones or all-zero mask
+      // that gates both the count and the history update.
+      static inline void step(uint64_t ga, uint64_t gb, uint64_t& h, uint64_t on,
+            uint64_t& counts)
+      {
+         uint64_t a = (ga >> h) & 1;
+         uint64_t b = (gb >> h) & 1;
+         counts += (on & 1) << (32 * a + 16 * b);
+         uint64_t next = ((h << 2) | (a << 1) | b) & (states - 1);
+         h = (h & ~on) | (next & on);
+      }
+};
+
+#endif
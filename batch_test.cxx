@@ -0,0 +1,126 @@
+// Checks Batch::play against Player::play and, for the shorter games,
+// against round-by-round Player::compete. Genomes are random, all
+// cooperate or all defect, and games run from 1 to 10^5 rounds. Prints
+// the first mismatches and exits non-zero if there are any.
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <array>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "rand.hxx"
+#include "player.hxx"
+#include "batch.hxx"
+
+size_t failures = 0;
+
+bool same(Player::Match const& x, Player::Match const& y)
+{
+   return x.score_a == y.score_a && x.score_b == y.score_b
+      && x.coop == y.coop && x.defect == y.defect && x.mixed == y.mixed;
+}
+
+void report(char const* against, Batch const& batch, size_t l, size_t rounds)
+{
+   if (++failures > 10)
+      return;
+   std::cerr << "mismatch against " << against << ": genomes "
+      << batch.genome_a[l] << ", " << batch.genome_b[l]
+      << ", history " << batch.history[l] << ", " << rounds << " rounds" << std::endl;
+}
+
+// Plays the game of lane l one round at a time.
+Player::Match compete(Batch const& batch, size_t l, size_t rounds)
+{
+   Player A(Player::Genome(batch.genome_a[l]));
+   Player B(Player::Genome(batch.genome_b[l]));
+   Player::PastGenes h(batch.history[l]);
+   A.clear_sums();
+   B.clear_sums();
+
+   Player::Match m;
+   for (size_t r = 0; r < rounds; ++r)
+   {
+      switch (Player::compete(A, B, h))
+      {
+         case Player::allCooperate: ++m.coop; break;
+         case Player::allDefect: ++m.defect; break;
+         case Player::mixed: ++m.mixed; break;
+      }
+   }
+   // over one pair and one game, the averages are the plain sums
+   A.calc_aves(2, 1);
+   B.calc_aves(2, 1);
+   m.score_a = A.score_ave;
+   m.score_b = B.score_ave;
+   return m;
+}
+
+void check(Batch& batch, size_t rounds)
+{
+   batch.play(rounds);
+   for (size_t l = 0; l < Batch::lanes; ++l)
+   {
+      auto expect = Player::play(Player::Genome(batch.genome_a[l]),
+         Player::Genome(batch.genome_b[l]), Player::PastGenes(batch.history[l]), rounds);
+      if (!same(batch.result[l], expect))
+         report("Player::play", batch, l, rounds);
+      if (rounds <= 1000 && !same(batch.result[l], compete(batch, l, rounds)))
+         report("Player::compete", batch, l, rounds);
+   }
+}
+
+int main()
+{
+   const std::vector<size_t> lengths = {1, 2, 3, 5, 10, 63, 64, 65, 100, 127, 128,
+      129, 191, 192, 193, 1000, 4097, 10000, 99999, 100000};
+   const uint64_t all_cooperate = 0, all_defect = ~uint64_t(0);
+
+   Rand rng(1);
+   size_t batches = 0;
+   for (size_t rounds : lengths)
+   {
+      for (int k = 0; k < 50; ++k)
+      {
+         Batch batch;
+         auto a = rng.genomes(Batch::lanes);
+         auto b = rng.genomes(Batch::lanes);
+         for (size_t l = 0; l < Batch::lanes; ++l)
+         {
+            // a few lanes of each batch play a fixed strategy
+            batch.genome_a[l] = l % 16 == 0 ? all_cooperate : a[l];
+            batch.genome_b[l] = l % 16 == 1 ? all_defect : b[l];
+            batch.history[l] = rng.below(Batch::states);
+         }
+         check(batch, rounds);
+         ++batches;
+      }
+
+      for (uint64_t a : {all_cooperate, all_defect})
+         for (uint64_t b : {all_cooperate, all_defect})
+         {
+            Batch batch;
+            for (size_t l = 0; l < Batch::lanes; ++l)
+            {
+               batch.genome_a[l] = a;
+               batch.genome_b[l] = b;
+               batch.history[l] = l;
+            }
+            check(batch, rounds);
+            ++batches;
+         }
+   }
+
+   if (failures) {
+      std::cerr << failures << " mismatches" << std::endl;
+      return 1;
+   }
+   std::cout << batches << " batches match" << std::endl;
+   return 0;
+}
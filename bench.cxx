@@ -0,0 +1,198 @@
+// Micro-benchmarks of the GA hot paths. Prints one JSON document with a
+// fixed set of benchmark names, in a fixed order, so that runs can be
+// diffed against each other for regressions.
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <array>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "rand.hxx"
+#include "player.hxx"
+#include "population.hxx"
+#include "simulation.hxx"
+#include "io.hxx"
+
+// results are folded into this so the optimiser cannot drop the work
+volatile unsigned long sink;
+
+struct Result
+{
+   std::string name;
+   size_t iterations;
+   double ns_per_op;
+};
+
+// Repeats op until min_time seconds have passed; ops_per_call is the
+// number of operations one call of op performs.
+template <typename Op>
+Result measure(std::string name, double min_time, size_t ops_per_call, Op op)
+{
+   op();   // warm up
+
+   size_t calls = 0;
+   double elapsed = 0;
+   Stopwatch clock;
+   do {
+      op();
+      ++calls;
+      elapsed += clock.lap();
+   } while (elapsed < min_time);
+
+   return {name, calls * ops_per_call, elapsed * 1e9 / (calls * ops_per_call)};
+}
+
+Simulation::Parameters bench_parameters(unsigned pop_size, size_t rounds,
+      size_t threads, std::string dir)
+{
+   Simulation::Parameters p;
+   p.pop_size = pop_size;
+   p.num_genetic_iter = 1;
+   p.num_compete_iter = rounds;
+   p.selection_rate = 0.2;
+   p.mutation_rate = 0.1;
+   p.weights.fill(1.0);
+   p.num_threads = threads;
+   p.seed = 1;
+   p.quiet = true;
+   p.output_dir = dir;
+   return p;
+}
+
+void remove_dir(std::string const& dir)
+{
+   if (DIR* d = opendir(dir.c_str())) {
+      while (dirent* e = readdir(d))
+         if (std::string(e->d_name) != "." && std::string(e->d_name) != "..")
+            unlink((dir + "/" + e->d_name).c_str());
+      closedir(d);
+   }
+   rmdir(dir.c_str());
+}
+
+int main(int argc, char* argv[])
+{
+   double min_time = 0.5;
+   size_t threads = 1;
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string arg(argv[i]);
+      if (arg == "--min-time" && i + 1 < argc)
+         min_time = std::stod(argv[++i]);
+      else if (arg == "--threads" && i + 1 < argc)
+         threads = std::max(1ul, std::stoul(argv[++i]));
+      else {
+         std::cerr << "usage: " << argv[0] << " [--min-time S] [--threads N]" << std::endl;
+         return 1;
+      }
+   }
+
+   char tmpl[] = "/tmp/ipd-bench-XXXXXX";
+   if (!mkdtemp(tmpl)) {
+      std::cerr << "cannot create a scratch directory" << std::endl;
+      return 1;
+   }
+   const std::string dir(tmpl);
+
+   Rand rng(1);
+   std::vector<Result> results;
+
+   {
+      Population p(2, rng);
+      Player A(p.genome(0)), B(p.genome(1));
+      Player::PastGenes h(0ul);
+      A.clear_sums();
+      B.clear_sums();
+      results.push_back(measure("player_compete", min_time, 1000, [&] {
+         for (int i = 0; i < 1000; ++i)
+            Player::compete(A, B, h);
+      }));
+   }
+
+   {
+      Population p(2, rng);
+      results.push_back(measure("player_play_1000_rounds", min_time, 1000, [&] {
+         for (int i = 0; i < 1000; ++i)
+            sink = sink + Player::play(p.genome(0), p.genome(1),
+               Player::PastGenes(static_cast<unsigned long>(i & 63)), 1000).score_a;
+      }));
+   }
+
+   {
+      auto bits = rng.genomes(2);
+      Player::Genome A(bits[0]), B(bits[1]);
+      auto points = rng.crossover_points(1000);
+      results.push_back(measure("genome_crossover", min_time, 1000, [&] {
+         for (auto c : points)
+            A = Player::Genome::crossover(A, B, c);
+         sink = sink + A.bits();
+      }));
+
+      auto sites = rng.mutation_sites(1000, 1);
+      results.push_back(measure("genome_mutate", min_time, 1000, [&] {
+         for (auto const& s : sites)
+            A.mutate(s.second);
+         sink = sink + A.bits();
+      }));
+   }
+
+   {
+      Population p(1000, rng);
+      Statistics weights;
+      weights.fill(1.0);
+      results.push_back(measure("population_calc_fitness", min_time, p.size(), [&] {
+         p.calc_fitness(weights, 1.0, 64.0, 0.0, 0.0);
+      }));
+
+      std::vector<double> shuffled(p.size());
+      for (auto& f : shuffled)
+         f = double(rng() >> 11) / double(1ull << 53);
+      results.push_back(measure("population_sort_1000", min_time, 1, [&] {
+         for (size_t i = 0; i < p.size(); ++i)
+            p.fitness[i] = shuffled[i];
+         p.sort();
+      }));
+
+      std::ofstream csv(dir + "/population.csv");
+      results.push_back(measure("population_csv_1000", min_time, 1, [&] {
+         csv.seekp(0);
+         csv << p;
+         csv.flush();
+      }));
+   }
+
+   for (unsigned pop_size : {50u, 200u, 1000u})
+      for (size_t rounds : {10ul, 1000ul, 100000ul})
+      {
+         Simulation sim(bench_parameters(pop_size, rounds, threads, dir));
+         Population p(pop_size, rng);
+         std::string name = "simulation_evaluate_pop" + std::to_string(pop_size)
+            + "_rounds" + std::to_string(rounds);
+         results.push_back(measure(name, min_time, 1, [&] { sim.evaluate(p); }));
+      }
+
+   remove_dir(dir);
+
+   std::cout << "{\n  \"min_time\": " << min_time
+      << ",\n  \"threads\": " << threads
+      << ",\n  \"benchmarks\": [\n";
+   for (size_t i = 0; i < results.size(); ++i)
+   {
+      auto const& r = results[i];
+      std::cout << "    {\"name\": \"" << r.name << "\", "
+         << "\"iterations\": " << r.iterations << ", "
+         << "\"ns_per_op\": " << r.ns_per_op << "}"
+         << (i + 1 < results.size() ? ",\n" : "\n");
+   }
+   std::cout << "  ]\n}" << std::endl;
+}
@@ -1,67 +1,34 @@
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
 #include <vector>
 #include <array>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <memory>
+#include <sstream>
+#include <thread>
 #include <sys/stat.h>
 
 #include "rand.hxx"
 #include "player.hxx"
 #include "population.hxx"
 #include "simulation.hxx"
+#include "io.hxx"
+#include "sweep.hxx"
+#include "island.hxx"
 
 using std::min;
 using std::max;
 
-std::ostream& operator<<(std::ostream& os, Player::PastGenes const& h)
-{
-   os << h.memory;
-   return os;
-}
-
-std::ostream& operator<<(std::ostream& os, Player::Decision const& c)
-{
-   os << ((c == Player::Decision::Cooperate) ? "cooperate" : "defect");
-   return os;
-}
-
-std::ostream& operator<<(std::ostream& os, Player::Genome const& s)
-{
-   os << s.genome;
-   return os;
-}
-
-std::ostream& operator<<(std::ostream& os, Player const& p)
-{
-   os << p.genome << ", " << p.fitness;
-   
-   return os;
-}
-
-std::ostream& operator<<(std::ostream& os, Population const& p)
-{
-   for (auto const& a : p.agents)
-      os << a << std::endl;
-   return os;
-}
-
-std::ostream& operator<<(std::ostream& os, Simulation::Parameters const& p)
-{
-   os << "Population Size, " << p.pop_size << std::endl
-      << "GA Iterations, " << p.num_genetic_iter << std::endl
-      << "Rounds per game, " << p.num_compete_iter << std::endl
-      << "Selection Rate, " << p.selection_rate << std::endl
-      << "Mutation Rate, " << p.mutation_rate << std::endl
-      << "Fitness Weights";
-   for (auto const& w : p.weights)
-      os << ", " << w;
-   os << std::endl;
-   return os;
-}
-
 std::istream& operator>>(std::istream & is, Simulation::Parameters& p)
 {
-   Simulation::Parameters tmp;
+   // settings that do not come from the record carry over
+   Simulation::Parameters tmp(p);
    is >> tmp.pop_size
       >> tmp.num_genetic_iter
       >> tmp.num_compete_iter
@@ -83,11 +50,122 @@ std::istream& operator>>(std::istream & is, Simulation::Parameters& p)
    return is;
 }
 
-int main()
+// Reads all of s as a decimal number in [lo, hi].
+template <typename T>
+bool parse_number(char const* s, T lo, T hi, T& out)
+{
+   // strtoull skips leading space and accepts a sign, turning "-1" into
+   // the largest value, so insist on a digit up front
+   if (!std::isdigit(static_cast<unsigned char>(*s)))
+      return false;
+   errno = 0;
+   char* end;
+   unsigned long long v = std::strtoull(s, &end, 10);
+   if (errno == ERANGE || *end != '\0' || v < lo || v > hi)
+      return false;
+   out = T(v);
+   return true;
+}
+
+int main(int argc, char* argv[])
 {
    Simulation::Parameters params;
+   const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+   params.num_threads = cores;
+   bool fixed_seed = false, fixed_threads = false;
+   bool sweep = false;
+   size_t jobs = cores;
+   Islands::Config islands;
+   
+   // threads, sweep jobs and island processes
+   const size_t max_workers = 1024;
+   const size_t max_count = std::numeric_limits<size_t>::max();
+   auto usage = [&]() {
+      std::cerr << "usage: " << argv[0]
+         << " [--threads N] [--seed S] [--quiet] [--binary-log] [--full-evaluate]"
+         << " [--sweep [--jobs J]]"
+         << " [--islands N [--migrate-every K] [--migrants M] [--topology ring|full]]"
+         << std::endl;
+      return 1;
+   };
+   
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string arg(argv[i]);
+      if (arg == "--threads" && i + 1 < argc) {
+         if (!parse_number(argv[++i], size_t(1), max_workers, params.num_threads))
+            return usage();
+         fixed_threads = true;
+      }
+      else if (arg == "--seed" && i + 1 < argc) {
+         if (!parse_number(argv[++i], uint64_t(0), std::numeric_limits<uint64_t>::max(), params.seed))
+            return usage();
+         fixed_seed = true;
+      }
+      else if (arg == "--quiet")
+         params.quiet = true;
+      else if (arg == "--binary-log")
+         params.binary_log = true;
+      else if (arg == "--full-evaluate")
+         params.incremental = false;
+      else if (arg == "--sweep")
+         sweep = true;
+      else if (arg == "--jobs" && i + 1 < argc) {
+         if (!parse_number(argv[++i], size_t(1), max_workers, jobs))
+            return usage();
+      }
+      else if (arg == "--islands" && i + 1 < argc) {
+         if (!parse_number(argv[++i], size_t(1), max_workers, islands.count))
+            return usage();
+      }
+      else if (arg == "--migrate-every" && i + 1 < argc) {
+         if (!parse_number(argv[++i], size_t(1), max_count, islands.every))
+            return usage();
+      }
+      else if (arg == "--migrants" && i + 1 < argc) {
+         if (!parse_number(argv[++i], size_t(0), max_count, islands.migrants))
+            return usage();
+      }
+      else if (arg == "--topology" && i + 1 < argc
+            && (std::string(argv[i+1]) == "ring" || std::string(argv[i+1]) == "full"))
+         islands.topology = (std::string(argv[++i]) == "ring") ? Islands::Ring : Islands::Full;
+      else
+         return usage();
+   }
+   
+   // islands are separate processes sharing the cores
+   if (islands.count > 1 && !fixed_threads)
+      params.num_threads = std::max<size_t>(1, cores / islands.count);
+   
+   // without --seed every run gets a fresh seed, recorded in its CSV files
+   std::random_device rd;
+   
+   if (sweep)
+   {
+      // the runs already fill the cores; don't split each one further
+      if (!fixed_threads)
+         params.num_threads = 1;
+      if (!fixed_seed)
+         params.seed = (uint64_t(rd()) << 32) | rd();
+      
+      std::vector<Simulation::Parameters> runs;
+      if (!Sweep::expand(std::cin, params, runs)) {
+         std::cerr << "sweep: nothing was run" << std::endl;
+         return 1;
+      }
+      Sweep s(runs, jobs, params.seed);
+      std::cout << s.run() << std::endl;
+      return 0;
+   }
+   
    while (std::cin >> params)
    {
+      if (!fixed_seed)
+         params.seed = (uint64_t(rd()) << 32) | rd();
+      if (islands.count > 1) {
+         std::cout << Islands(params, islands).run() << std::endl;
+         continue;
+      }
       Simulation sim(params);
       sim.genetic();
    }
@@ -0,0 +1,269 @@
+#ifndef _GENLOG_
+#define _GENLOG_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "player.hxx"
+#include "population.hxx"
+
+// Binary generation log.
+//
+// The file is a LogHeader followed by records, each a RecordHeader and
+// its payload. A Demographics record carries one Demographics. A
+// population record carries `count` agents stored column by column:
+// genomes as uint64, then fitness, score, diversity and each of the
+// stats as doubles. Every field is 8 bytes wide and in host byte order.
+struct LogHeader
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t num_stats;
+   uint64_t pop_size, num_genetic_iter, num_compete_iter, seed;
+   double selection_rate, mutation_rate;
+   Statistics weights;
+
+   // the 8 bytes of magic, padding included
+   static char const* expected_magic() { return "IPDLOG\0"; }
+   static constexpr uint32_t current_version = 2;
+};
+
+struct Demographics
+{
+   uint64_t generation, selected;
+   double fitness_mean, fitness_sd;
+   double score_mean, score_sd;
+   double diversity_mean, diversity_sd;
+   Statistics stat_means;
+   double coop_prop, defect_prop, mixed_prop;
+   // cost of producing the generation
+   double evaluate_seconds, breed_seconds, log_seconds;
+   uint64_t games;
+   double rounds_per_second;
+   // bytes the generation added to the logs, its own demographics
+   // records and, in the last generation, the final population included
+   uint64_t bytes_logged;
+};
+
+struct RecordHeader
+{
+   enum Kind : uint32_t { Demographic, Initial, Next, Final };
+
+   uint32_t kind;
+   uint32_t reserved;
+   uint64_t generation;
+   uint64_t count;
+};
+
+// Appends records to an in-memory buffer; commit() hands the buffer to a
+// background thread that writes it out, and the GA carries on with a
+// recycled buffer. At most max_pending buffers are handed over at once,
+// counting the one being written; if the disk falls that far behind,
+// commit() waits for it rather than letting memory grow.
+class GenerationLog
+{
+   public:
+      static constexpr size_t max_pending = 2;
+
+      GenerationLog(std::string const& path, LogHeader const& h)
+         : name(path),
+           file(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc),
+           writer(&GenerationLog::drain, this)
+      {
+         if (!file)
+            std::cerr << name << ": cannot open for writing" << std::endl;
+         append(&h, sizeof h);
+         commit();
+      }
+
+      GenerationLog(GenerationLog const&) = delete;
+      GenerationLog& operator=(GenerationLog const&) = delete;
+
+      ~GenerationLog()
+      {
+         commit();
+         {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+         }
+         ready.notify_one();
+         writer.join();
+      }
+
+      // size of one demographics record
+      static size_t demographics_size() { return sizeof(RecordHeader) + sizeof(Demographics); }
+
+      void demographics(Demographics const& d)
+      {
+         RecordHeader r{RecordHeader::Demographic, 0, d.generation, 1};
+         append(&r, sizeof r);
+         append(&d, sizeof d);
+      }
+
+      void population(RecordHeader::Kind kind, uint64_t generation, Population const& p)
+      {
+         RecordHeader r{kind, 0, generation, p.size()};
+         append(&r, sizeof r);
+
+         column(p.genomes);
+         column(p.fitness);
+         column(p.score_ave);
+         column(p.diversity_ave);
+         for (auto const& c : p.stats)
+            column(c);
+      }
+
+      void commit()
+      {
+         if (filling.empty())
+            return;
+         {
+            std::unique_lock<std::mutex> lock(mtx);
+            written.wait(lock, [this] { return pending.size() + writing < max_pending; });
+            pending.push_back(std::move(filling));
+            if (spare.empty())
+               filling = std::vector<char>();
+            else {
+               filling = std::move(spare.back());
+               spare.pop_back();
+            }
+         }
+         ready.notify_one();
+      }
+
+      uint64_t bytes() const { return logged; }
+
+   private:
+      void append(void const* data, size_t n)
+      {
+         char const* c = static_cast<char const*>(data);
+         filling.insert(filling.end(), c, c + n);
+         logged += n;
+      }
+
+      template <typename T>
+      void column(std::vector<T> const& c) { append(c.data(), c.size() * sizeof(T)); }
+
+      void drain()
+      {
+         std::unique_lock<std::mutex> lock(mtx);
+         for (;;)
+         {
+            ready.wait(lock, [this] { return stop || !pending.empty(); });
+            if (pending.empty())
+               return;
+
+            std::vector<char> buf = std::move(pending.front());
+            pending.pop_front();
+            writing = 1;
+            lock.unlock();
+
+            if (file && !file.write(buf.data(), buf.size()))
+               std::cerr << name << ": write failed" << std::endl;
+            buf.clear();
+
+            lock.lock();
+            spare.push_back(std::move(buf));
+            writing = 0;
+            written.notify_one();
+         }
+      }
+
+      std::string name;
+      std::ofstream file;
+      std::vector<char> filling;
+      std::deque<std::vector<char>> pending;
+      std::vector<std::vector<char>> spare;
+      uint64_t logged = 0;
+
+      std::mutex mtx;
+      std::condition_variable ready, written;
+      size_t writing = 0;
+      bool stop = false;
+      std::thread writer;
+};
+
+// Read-only walk over a log held in memory (e.g. memory-mapped).
+class LogView
+{
+   public:
+      LogView(char const* _data, size_t _size) : data(_data), size(_size), pos(sizeof(LogHeader)) {}
+
+      bool valid() const
+      {
+         if (size < sizeof(LogHeader))
+            return false;
+         LogHeader h = header();
+         return std::memcmp(h.magic, LogHeader::expected_magic(), sizeof h.magic) == 0
+            && h.version == LogHeader::current_version
+            && h.num_stats == std::tuple_size<Statistics>::value;
+      }
+
+      LogHeader header() const { return at<LogHeader>(0); }
+
+      // Moves to the next record; payload points at its first byte.
+      bool next(RecordHeader& r, char const*& payload)
+      {
+         if (pos + sizeof r > size)
+            return false;
+         r = at<RecordHeader>(pos);
+         size_t n = (r.kind == RecordHeader::Demographic)
+            ? sizeof(Demographics)
+            : r.count * sizeof(uint64_t) * (4 + std::tuple_size<Statistics>::value);
+         if (pos + sizeof r + n > size)
+            return false;
+         payload = data + pos + sizeof r;
+         pos += sizeof r + n;
+         return true;
+      }
+
+      static Demographics demographics(char const* payload)
+      {
+         return read<Demographics>(payload);
+      }
+
+      static Population population(RecordHeader const& r, char const* payload)
+      {
+         const size_t n = r.count;
+         Population p;
+         for (size_t i = 0; i < n; ++i)
+            p.add(read<uint64_t>(payload + i * 8));
+
+         auto column = [&](size_t c, std::vector<double>& out) {
+            for (size_t i = 0; i < n; ++i)
+               out[i] = read<double>(payload + (c * n + i) * 8);
+         };
+         column(1, p.fitness);
+         column(2, p.score_ave);
+         column(3, p.diversity_ave);
+         for (size_t s = 0; s < p.stats.size(); ++s)
+            column(4 + s, p.stats[s]);
+         return p;
+      }
+
+   private:
+      template <typename T>
+      static T read(char const* where)
+      {
+         T value;
+         std::memcpy(&value, where, sizeof value);
+         return value;
+      }
+
+      template <typename T>
+      T at(size_t offset) const { return read<T>(data + offset); }
+
+      char const* data;
+      size_t size;
+      size_t pos;
+};
+
+#endif
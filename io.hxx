@@ -0,0 +1,57 @@
+#ifndef _IO_
+#define _IO_
+
+#include <iostream>
+
+#include "player.hxx"
+#include "population.hxx"
+#include "simulation.hxx"
+
+inline std::ostream& operator<<(std::ostream& os, Player::PastGenes const& h)
+{
+   os << h.memory;
+   return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, Player::Decision const& c)
+{
+   os << ((c == Player::Decision::Cooperate) ? "cooperate" : "defect");
+   return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, Player::Genome const& s)
+{
+   os << s.genome;
+   return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, Player const& p)
+{
+   os << p.genome << ", " << p.fitness;
+   
+   return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, Population const& p)
+{
+   for (size_t i = 0; i < p.size(); ++i)
+      os << p.genome(i) << ", " << p.fitness[i] << '\n';
+   return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, Simulation::Parameters const& p)
+{
+   os << "Population Size, " << p.pop_size << std::endl
+      << "GA Iterations, " << p.num_genetic_iter << std::endl
+      << "Rounds per game, " << p.num_compete_iter << std::endl
+      << "Selection Rate, " << p.selection_rate << std::endl
+      << "Mutation Rate, " << p.mutation_rate << std::endl
+      << "Seed, " << p.seed << std::endl
+      << "Fitness Weights";
+   for (auto const& w : p.weights)
+      os << ", " << w;
+   os << std::endl;
+   return os;
+}
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef _ISLAND_
+#define _ISLAND_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "rand.hxx"
+#include "simulation.hxx"
+
+// Island model. Each island is a separate worker process running the
+// ordinary Simulation loop on its own population. Every `every`
+// generations each island sends its best `migrants` agents to the
+// coordinator over a Unix socket. The coordinator routes them along the
+// topology, and the receiving island puts the best of what arrives in
+// place of its worst survivors. Workers also report their demographics
+// every generation; the coordinator writes them to islandsN/demographics.csv.
+struct Islands
+{
+      enum Topology { Ring, Full };
+
+      struct Config
+      {
+         size_t count = 1;
+         size_t every = 10;
+         size_t migrants = 1;
+         Topology topology = Ring;
+      };
+
+      Islands(Simulation::Parameters _params, Config _config)
+         : params(std::move(_params)), config(_config) {}
+
+      // Runs all islands to completion; returns the output directory.
+      std::string run()
+      {
+         std::string dir = makeUniqueDir("islands");
+         Rand seeds(params.seed);
+
+         std::vector<int> links;
+         std::vector<pid_t> workers;
+         std::cout.flush();
+         for (size_t i = 0; i < config.count; ++i)
+         {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+               std::cerr << "islands: socketpair failed" << std::endl;
+               break;
+            }
+
+            Simulation::Parameters p(params);
+            p.seed = seeds.at(i);
+            p.quiet = true;
+            p.output_dir = dir + "/island" + std::to_string(i);
+            mkdir(p.output_dir.c_str(), 0777);
+
+            pid_t pid = fork();
+            if (pid == 0) {
+               close(fds[0]);
+               for (int l : links)
+                  close(l);
+               island(i, p, fds[1]);
+               close(fds[1]);
+               _exit(0);
+            }
+            close(fds[1]);
+            if (pid < 0) {
+               std::cerr << "islands: fork failed" << std::endl;
+               close(fds[0]);
+               break;
+            }
+            links.push_back(fds[0]);
+            workers.push_back(pid);
+         }
+
+         coordinate(dir, links);
+
+         for (int l : links)
+            close(l);
+         for (pid_t w : workers)
+            waitpid(w, nullptr, 0);
+         return dir;
+      }
+
+   private:
+      struct Message
+      {
+         enum Kind : uint32_t { Demographic, Migrants, Done };
+
+         uint32_t kind;
+         uint32_t island;
+         uint64_t count;
+      };
+
+      struct Migrant
+      {
+         uint64_t genome;
+         double fitness;
+      };
+
+      // A peer that has gone away shows up as a failed send rather than a
+      // SIGPIPE, so one lost island does not take the others down with it.
+      static bool send_all(int fd, void const* data, size_t n)
+      {
+         char const* c = static_cast<char const*>(data);
+         while (n > 0)
+         {
+            ssize_t k = send(fd, c, n, MSG_NOSIGNAL);
+            if (k < 0 && errno == EINTR)
+               continue;
+            if (k <= 0)
+               return false;
+            c += k;
+            n -= k;
+         }
+         return true;
+      }
+
+      static bool recv_all(int fd, void* data, size_t n)
+      {
+         char* c = static_cast<char*>(data);
+         while (n > 0)
+         {
+            ssize_t k = read(fd, c, n);
+            if (k < 0 && errno == EINTR)
+               continue;
+            if (k <= 0)
+               return false;
+            c += k;
+            n -= k;
+         }
+         return true;
+      }
+
+      static bool send_migrants(int fd, uint32_t island, std::vector<Migrant> const& m)
+      {
+         Message h{Message::Migrants, island, m.size()};
+         return send_all(fd, &h, sizeof h)
+            && send_all(fd, m.data(), m.size() * sizeof(Migrant));
+      }
+
+      // Worker process: one island.
+      void island(size_t i, Simulation::Parameters const& p, int fd)
+      {
+         Simulation sim(p);
+         sim.on_generation([&](size_t g, Population& pop) {
+            Demographics d = sim.last_demographics();
+            Message h{Message::Demographic, uint32_t(i), 1};
+            send_all(fd, &h, sizeof h);
+            send_all(fd, &d, sizeof d);
+
+            if ((g + 1) % config.every != 0 || g + 1 == p.num_genetic_iter)
+               return;
+
+            // the front of the population is still ranked from the last evaluation
+            std::vector<Migrant> out;
+            for (size_t a = 0; a < std::min(config.migrants, pop.size()); ++a)
+               out.push_back({pop.genomes[a], pop.fitness[a]});
+            send_migrants(fd, i, out);
+
+            Message r;
+            std::vector<Migrant> in;
+            if (!recv_all(fd, &r, sizeof r))
+               return;
+            in.resize(r.count);
+            if (!recv_all(fd, in.data(), in.size() * sizeof(Migrant)))
+               return;
+
+            // the worst survivors sit just ahead of the newly moved-in agents
+            size_t end = pop.size() - std::min(sim.selected(), pop.size());
+            size_t n = std::min(in.size(), end);
+            for (size_t a = 0; a < n; ++a)
+               pop.replace(end - n + a, in[a].genome);
+         });
+         sim.genetic();
+
+         Message done{Message::Done, uint32_t(i), 0};
+         send_all(fd, &done, sizeof done);
+      }
+
+      // Coordinator: logs demographics and routes each round of migrants.
+      // Links are polled so that every island is read as soon as it writes;
+      // a round of migration goes out once every live island has sent its
+      // migrants.
+      void coordinate(std::string const& dir, std::vector<int> const& links)
+      {
+         std::ofstream demographics_csv(dir + "/demographics.csv");
+         demographics_csv << params << std::endl
+            << "Islands, " << links.size() << std::endl
+            << "Migration Interval, " << config.every << std::endl
+            << "Migrants, " << config.migrants << std::endl
+            << "Topology, " << (config.topology == Ring ? "ring" : "full") << std::endl
+            << std::endl << "Island, ";
+         Simulation::print_demographics_columns(demographics_csv);
+         demographics_csv << std::endl;
+
+         const size_t n = links.size();
+         std::vector<std::vector<Migrant>> outgoing(n);
+         std::vector<bool> done(n, false), waiting(n, false);
+         size_t live = n, migrating = 0;
+         while (live > 0)
+         {
+            std::vector<pollfd> ready;
+            std::vector<size_t> which;
+            for (size_t i = 0; i < n; ++i)
+               if (!done[i] && !waiting[i]) {
+                  ready.push_back({links[i], POLLIN, 0});
+                  which.push_back(i);
+               }
+
+            if (poll(ready.data(), ready.size(), -1) < 0) {
+               if (errno == EINTR)
+                  continue;
+               std::cerr << "islands: poll failed" << std::endl;
+               return;
+            }
+
+            for (size_t k = 0; k < ready.size(); ++k)
+            {
+               if (ready[k].revents == 0)
+                  continue;
+               const size_t i = which[k];
+
+               Message h;
+               bool ok = recv_all(links[i], &h, sizeof h);
+               if (ok && h.kind == Message::Demographic) {
+                  Demographics d;
+                  ok = recv_all(links[i], &d, sizeof d);
+                  if (ok) {
+                     demographics_csv << i << ", ";
+                     Simulation::print_demographics(demographics_csv, d);
+                  }
+               }
+               else if (ok && h.kind == Message::Migrants) {
+                  outgoing[i].resize(h.count);
+                  ok = recv_all(links[i], outgoing[i].data(), h.count * sizeof(Migrant));
+                  if (ok) {
+                     waiting[i] = true;
+                     ++migrating;
+                  }
+               }
+               else if (ok) {
+                  done[i] = true;
+                  --live;
+               }
+
+               if (!ok) {
+                  outgoing[i].clear();
+                  lose(i, done, live);
+               }
+            }
+
+            if (migrating == 0 || migrating < live)
+               continue;
+
+            std::vector<std::vector<Migrant>> in(n);
+            for (size_t i = 0; i < n; ++i)
+               if (waiting[i])
+                  in[i] = incoming(i, outgoing);
+            for (size_t i = 0; i < n; ++i)
+            {
+               if (waiting[i] && !send_migrants(links[i], i, in[i]))
+                  lose(i, done, live);
+               outgoing[i].clear();
+               waiting[i] = false;
+            }
+            migrating = 0;
+         }
+      }
+
+      static void lose(size_t i, std::vector<bool>& done, size_t& live)
+      {
+         std::cerr << "islands: lost island " << i << std::endl;
+         done[i] = true;
+         --live;
+      }
+
+      std::vector<Migrant> incoming(size_t i, std::vector<std::vector<Migrant>> const& outgoing) const
+      {
+         const size_t n = outgoing.size();
+         std::vector<Migrant> in;
+         if (n < 2)
+            return in;
+
+         if (config.topology == Ring)
+            in = outgoing[(i + n - 1) % n];
+         else
+            for (size_t j = 0; j < n; ++j)
+               if (j != i)
+                  in.insert(in.end(), outgoing[j].begin(), outgoing[j].end());
+
+         std::stable_sort(in.begin(), in.end(),
+            [](Migrant const& a, Migrant const& b) { return b.fitness < a.fitness; });
+         if (in.size() > config.migrants)
+            in.resize(config.migrants);
+         return in;
+      }
+
+      Simulation::Parameters params;
+      Config config;
+};
+
+#endif
@@ -0,0 +1,115 @@
+// Converts a binary generation log (genetic --binary-log) back into the
+// CSV files a text run writes: demographics, final_population and, with
+// --all, all_population.
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <array>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "rand.hxx"
+#include "player.hxx"
+#include "population.hxx"
+#include "simulation.hxx"
+#include "io.hxx"
+
+int convert(std::string const& path, bool all)
+{
+   int fd = open(path.c_str(), O_RDONLY);
+   if (fd < 0) {
+      std::cerr << path << ": cannot open" << std::endl;
+      return 1;
+   }
+   struct stat st;
+   if (fstat(fd, &st) != 0) {
+      std::cerr << path << ": cannot stat" << std::endl;
+      close(fd);
+      return 1;
+   }
+   size_t size = st.st_size;
+   void* map = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+   close(fd);
+   if (map == MAP_FAILED) {
+      std::cerr << path << ": cannot map" << std::endl;
+      return 1;
+   }
+
+   LogView log(static_cast<char const*>(map), size);
+   if (!log.valid()) {
+      std::cerr << path << ": not a generation log" << std::endl;
+      munmap(map, size);
+      return 1;
+   }
+
+   std::string stem = path.substr(0, path.rfind('.'));
+   Simulation::Parameters params = Simulation::parameters(log.header());
+
+   std::ofstream demographics_csv(stem + "_demographics.csv");
+   std::ofstream final_population_file(stem + "_final_population.csv");
+   std::ofstream all_population_file;
+   demographics_csv << params;
+   Simulation::print_demographics_headings(demographics_csv);
+   final_population_file << params;
+   Simulation::print_finalpop_headings(final_population_file);
+   if (all) {
+      all_population_file.open(stem + "_all_population.csv");
+      all_population_file << params;
+   }
+
+   RecordHeader r;
+   char const* payload;
+   while (log.next(r, payload))
+   {
+      switch (r.kind)
+      {
+         case RecordHeader::Demographic:
+            Simulation::print_demographics(demographics_csv, LogView::demographics(payload));
+            break;
+         case RecordHeader::Initial:
+         case RecordHeader::Next:
+            if (all)
+               all_population_file << LogView::population(r, payload) << '\n';
+            break;
+         case RecordHeader::Final:
+            Simulation::print_finalpop(final_population_file, LogView::population(r, payload));
+            break;
+      }
+   }
+
+   munmap(map, size);
+   return 0;
+}
+
+int main(int argc, char* argv[])
+{
+   bool all = false;
+   std::vector<std::string> logs;
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string arg(argv[i]);
+      if (arg == "--all")
+         all = true;
+      else
+         logs.push_back(arg);
+   }
+   if (logs.empty()) {
+      std::cerr << "usage: " << argv[0] << " [--all] LOG..." << std::endl;
+      return 1;
+   }
+
+   int status = 0;
+   for (auto const& l : logs)
+      status |= convert(l, all);
+   return status;
+}
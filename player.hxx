@@ -7,6 +7,41 @@
 
 static constexpr size_t combation_pairs(size_t n) { return n * (n-1) / 2; }
 
+// Bit h of the result is set for each history from h to 63 that
+// satisfies pred.
+static constexpr unsigned long long history_mask(bool (*pred)(unsigned long),
+        unsigned long h = 0)
+{
+    return h == 64 ? 0 : ((pred(h) ? 1ull << h : 0) | history_mask(pred, h + 1));
+}
+
+// Trait predicates over a 6-bit history, matching the PastGenes
+// predicates: bits 0, 2 and 4 are the opponent's moves, 1, 3 and 5 ours.
+// Round i was a sucker's payoff when its two bits are 01.
+static constexpr int suckered(unsigned long h, int i) { return (h >> 2*i & 3) == 1; }
+static constexpr int suckering(unsigned long h, int i) { return (h >> 2*i & 3) == 2; }
+
+static constexpr bool nice_history(unsigned long h)
+{
+    return (h & 0x15) == 0;
+}
+
+static constexpr bool forgiving_history(unsigned long h)
+{
+    return (h & 0x15) != 0 && !suckered(h, 0) && !suckered(h, 1) && !suckered(h, 2);
+}
+
+static constexpr bool retaliating_history(unsigned long h)
+{
+    return (h & 0x15) == 0x15 || suckered(h, 0) || suckered(h, 1) || suckered(h, 2);
+}
+
+static constexpr bool nonenvious_history(unsigned long h)
+{
+    return suckered(h, 0) + suckered(h, 1) + suckered(h, 2)
+        == suckering(h, 0) + suckering(h, 1) + suckering(h, 2);
+}
+
 using Statistics = std::array<double, 6>;
 
 struct Player
@@ -15,7 +50,6 @@ struct Player
 
     struct PastGenes
     {
-        PastGenes() : memory(Rand::random_6_bits()) {};
         PastGenes(std::string s) : memory(s) {};
         PastGenes(unsigned long l) : memory(l) {};
 
@@ -76,13 +110,13 @@ struct Player
     };
     struct Genome
     {
-        Genome() : genome(Rand::random_64_bits()) {}
+        Genome() : genome(0) {}
+        Genome(unsigned long long bits) : genome(bits) {}
         Genome(std::string s) : genome(s) {};
 
-        static Genome crossover(Genome A, Genome B)
+        static Genome crossover(Genome A, Genome B, unsigned long cpoint)
         {
             static const Genome mask("1111111111111111111111111111111111111111111111111111111111111111");
-            unsigned long cpoint = Rand::rand(1,63);
             Genome next;
             next.genome = (A.genome & (mask.genome << cpoint)) | (B.genome & (mask.genome >> (64 - cpoint)));
             auto retVal = std::move(next);
@@ -91,11 +125,12 @@ struct Player
 
         static unsigned long countUniqueBits(Genome const& a, Genome const& b)
         {
-            std::bitset<64> s(a.genome ^ b.genome);
-            unsigned long sum = 0;
-            for (int i = 0; i < 64; ++i)
-                sum += s[i];
-            return sum;
+            return (a.genome ^ b.genome).count();
+        }
+
+        unsigned long long bits() const
+        {
+            return genome.to_ullong();
         }
 
         Decision decide(PastGenes const& pg) const
@@ -103,9 +138,8 @@ struct Player
             return (genome[pg.get()] ? Decision::Defect : Decision::Cooperate);
         }
 
-        void mutate()
+        void mutate(unsigned long mpoint)
         {
-            unsigned long mpoint = Rand::rand(0,63);
             genome[mpoint].flip();
         }
 
@@ -122,13 +156,9 @@ struct Player
             return 0;
         }
 
-        double calc_forgiveness()
+        double calc_forgiveness() const
         {
-            double sum = 0.0;
-            for (unsigned long i = 0; i < 64; ++i)
-                sum += forgiveness(PastGenes(i));  
-            assert((sum >= -19) && (sum <= 19)); 
-            return (sum + 19)/(19*2);
+            return cooperation(forgiving_mask);
         }
 
         int niceness(PastGenes const & h) const
@@ -142,13 +172,9 @@ struct Player
             return 0;
         }
 
-        double calc_niceness()
+        double calc_niceness() const
         {
-            double sum = 0.0;
-            for (unsigned long i = 0; i < 64; ++i)
-                sum += niceness(PastGenes(i));   
-            assert((sum >= -8) && (sum <= 8));
-            return (sum + 8)/(8*2);
+            return cooperation(nice_mask);
         }
 
         int retaliation(PastGenes const & h) const
@@ -164,13 +190,9 @@ struct Player
             return 0;
         }
 
-        double calc_retaliation()
+        double calc_retaliation() const
         {
-            double sum = 0.0;
-            for (unsigned long i = 0; i < 64; ++i)
-                sum += retaliation(PastGenes(i)); 
-            assert((sum >= -38) && (sum <= 38));
-            return (sum + 38)/(38*2);
+            return defection(retaliating_mask);
         }
 
         int non_envy(PastGenes const & h) const
@@ -184,21 +206,55 @@ struct Player
             return 0;
         }
 
-        double calc_nonenvy()
+        double calc_nonenvy() const
+        {
+            return cooperation(nonenvious_mask);
+        }
+
+        // Histories counted by each trait.
+        static constexpr unsigned long long nice_mask = history_mask(nice_history);
+        static constexpr unsigned long long forgiving_mask = history_mask(forgiving_history);
+        static constexpr unsigned long long retaliating_mask = history_mask(retaliating_history);
+        static constexpr unsigned long long nonenvious_mask = history_mask(nonenvious_history);
+
+        // +1 for each history in mask met with cooperation and -1 for each
+        // met with defection, scaled to [0, 1].
+        double cooperation(unsigned long long mask) const
+        {
+            return cooperation(mask, defections(mask));
+        }
+
+        // As cooperation, with the signs swapped.
+        double defection(unsigned long long mask) const
+        {
+            return defection(mask, defections(mask));
+        }
+
+        // The same scores for a genome that defects on `defects` of the
+        // histories in mask.
+        static double cooperation(unsigned long long mask, size_t defects)
+        {
+            double n = std::bitset<64>(mask).count();
+            return (n - defects) / n;
+        }
+
+        static double defection(unsigned long long mask, size_t defects)
+        {
+            return double(defects) / std::bitset<64>(mask).count();
+        }
+
+        // number of the histories in mask met with defection
+        size_t defections(unsigned long long mask) const
         {
-            double sum = 0.0;
-            for (unsigned long i = 0; i < 64; ++i)
-                sum += non_envy(PastGenes(i)); 
-            assert((sum >= -20) && (sum <= 20));
-            return (sum + 20)/(20*2);
+            return (genome & std::bitset<64>(mask)).count();
         }
 
         friend std::ostream& operator<<(std::ostream& os, Genome const& s);
         private:
         std::bitset<64> genome;
     };
-    Player() : genome(), fitness(7.75), score_ave(7.75), diversity_ave(32) {}
-    Player(Genome _genome) : genome(_genome), fitness(7.75), score_ave(7.75), diversity_ave(32) {}
+    Player() : genome(), fitness(7.75), score_ave(7.75), diversity_ave(32), stats() {}
+    Player(Genome _genome) : genome(_genome), fitness(7.75), score_ave(7.75), diversity_ave(32), stats() {}
 
     Genome genome;
     double fitness;
@@ -242,6 +298,12 @@ struct Player
         diversity_sum = 0;
     }
 
+    void add_sums(unsigned long score, unsigned long diversity)
+    {
+        score_sum += score;
+        diversity_sum += diversity;
+    }
+
     static void diversity(Player & a, Player& b)
     {
         unsigned long sum = Genome::countUniqueBits(a.genome, b.genome);
@@ -279,6 +341,68 @@ struct Player
                );
     }
 
+    // Outcome of a whole game, accumulated without touching either Player,
+    // so games can be played concurrently.
+    struct Match
+    {
+        unsigned long score_a = 0, score_b = 0;
+        unsigned long coop = 0, defect = 0, mixed = 0;
+
+        void add(Decision a, Decision b, unsigned long times = 1)
+        {
+            score_a += score(a,b) * times;
+            score_b += score(b,a) * times;
+            if (a==Cooperate && b==Cooperate)
+                coop += times;
+            else if (a==Defect && b==Defect)
+                defect += times;
+            else
+                mixed += times;
+        }
+    };
+
+    // A game is a walk over the 64 possible histories, so it must revisit
+    // one within 64 rounds. The rounds up to the first repeat are played
+    // out; the rest of the game is that cycle repeated, and is added in
+    // closed form.
+    static Match play(Genome const& A, Genome const& B, PastGenes H, size_t rounds)
+    {
+        static constexpr size_t states = 64;
+
+        // round at which each history was first entered, or -1
+        std::array<long, states> entered;
+        entered.fill(-1);
+        std::array<Decision, states> dec_a, dec_b;
+
+        Match m;
+        size_t r = 0;
+        for (; r < rounds; ++r)
+        {
+            unsigned long h = H.get();
+            if (entered[h] >= 0)
+                break;
+            entered[h] = long(r);
+
+            dec_a[r] = A.decide(H);
+            dec_b[r] = B.decide(H);
+            m.add(dec_a[r], dec_b[r]);
+            H.save(dec_a[r], dec_b[r]);
+        }
+        if (r == rounds)
+            return m;
+
+        // rounds [start, r) form the cycle
+        const size_t start = entered[H.get()];
+        const size_t period = r - start;
+        const size_t left = rounds - r;
+        const size_t laps = left / period;
+        const size_t tail = left % period;
+
+        for (size_t i = start; i < r; ++i)
+            m.add(dec_a[i], dec_b[i], laps + (i - start < tail ? 1 : 0));
+        return m;
+    }
+
     friend std::ostream& operator<<(std::ostream& os, Player const& p);
     private:
     unsigned long score_sum;
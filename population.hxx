@@ -3,123 +3,247 @@
 
 #include <iostream>
 
+#include "scores.hxx"
+
+// Agents are stored column by column: agent i is genomes[i], fitness[i],
+// score_ave[i], and so on. Per-agent values start out as a default
+// constructed Player's, and sort() keeps the columns in step.
 class Population
 {
    public:
-      std::vector<Player> agents;
-      
-      Population(size_t n) : agents(n) {}
+      static constexpr size_t num_stats = std::tuple_size<Statistics>::value;
+
+      std::vector<uint64_t> genomes;
+      std::vector<double> fitness, score_ave, diversity_ave;
+      std::array<std::vector<double>, num_stats> stats;
+      // position of each agent in scores (size_t(-1) until it has one)
+      std::vector<size_t> slots;
+      ScoreMatrix scores;
+
+      Population() {}
+      Population(size_t n, Rand& rng)
+      {
+         for (auto bits : rng.genomes(n))
+            add(bits);
+      }
       Population(Population& p) = default;
       Population(Population&& p) = default;
-      
+
+      // Appends a new, unscored agent.
+      void add(uint64_t genome)
+      {
+         static const Player blank;
+         genomes.push_back(genome);
+         fitness.push_back(blank.fitness);
+         score_ave.push_back(blank.score_ave);
+         diversity_ave.push_back(blank.diversity_ave);
+         for (size_t s = 0; s < num_stats; ++s)
+            stats[s].push_back(blank.stats[s]);
+         slots.push_back(size_t(-1));
+      }
+
+      // Puts a new, unscored agent in place of agent i.
+      void replace(size_t i, uint64_t genome)
+      {
+         static const Player blank;
+         genomes[i] = genome;
+         fitness[i] = blank.fitness;
+         score_ave[i] = blank.score_ave;
+         diversity_ave[i] = blank.diversity_ave;
+         for (size_t s = 0; s < num_stats; ++s)
+            stats[s][i] = blank.stats[s];
+         slots[i] = size_t(-1);
+      }
+
+      // Drops the agents from n on.
+      void truncate(size_t n)
+      {
+         genomes.resize(n);
+         fitness.resize(n);
+         score_ave.resize(n);
+         diversity_ave.resize(n);
+         for (auto& c : stats)
+            c.resize(n);
+         slots.resize(n);
+      }
+
+      Player::Genome genome(size_t i) const { return Player::Genome(genomes[i]); }
+
+      // Best fitness first. The order matches sorting the agents
+      // themselves with the same comparison.
       void sort()
       {
-         std::sort(std::begin(agents),std::end(agents),
-            [](Player const& A, Player const& B)->bool {return B.fitness < A.fitness;});
+         std::vector<size_t> order(size());
+         for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+         std::sort(std::begin(order),std::end(order),
+            [this](size_t A, size_t B)->bool {return fitness[B] < fitness[A];});
+
+         permute(genomes, order);
+         permute(fitness, order);
+         permute(score_ave, order);
+         permute(diversity_ave, order);
+         for (auto& c : stats)
+            permute(c, order);
+         permute(slots, order);
       }
-      
-      void get_max(double& max_sco, double& max_div)
+
+      // Average score and diversity from each agent's game sums, as
+      // Player::calc_aves.
+      void calc_aves(std::vector<unsigned long> const& score_sum,
+            std::vector<unsigned long> const& diversity_sum,
+            double const pop_size, double const num_games)
       {
-         assert(agents.size()!=0);
-         
-         auto first = std::begin(agents); 
-         auto last = std::end(agents);
-
-         max_sco = first->score_ave;
-         max_div = first->diversity_ave;
-         
-         while (++first!=last)
-         {
-            if (max_sco < first->score_ave)
-               max_sco = first->score_ave;
-            if (max_div < first->diversity_ave)
-               max_div = first->diversity_ave;
-         } 
+         const size_t n = size();
+         for (size_t i = 0; i < n; ++i)
+            score_ave[i] = double(score_sum[i]) / (combation_pairs(pop_size) * num_games);
+         for (size_t i = 0; i < n; ++i)
+            diversity_ave[i] = double(diversity_sum[i]) / combation_pairs(pop_size);
       }
-      
-      void get_min(double& min_sco, double& min_div)
+
+      // Player::calc_fitness for every agent, one column at a time.
+      void calc_fitness(Statistics const& weights, double const max_score,
+            double const max_diversity, double const min_score, double const min_diversity)
       {
-         assert(agents.size()!=0);
-         
-         auto first = std::begin(agents); 
-         auto last = std::end(agents);
-
-         min_sco = first->score_ave;
-         min_div = first->diversity_ave;
-         
-         while (++first!=last)
+         const size_t n = size();
+
+         if ((int(max_score*100000) != 0) && (max_score != min_score))
+            for (size_t i = 0; i < n; ++i)
+               stats[0][i] = 1.0 - ((score_ave[i] - min_score) / (max_score - min_score));
+         else
+            std::fill(stats[0].begin(), stats[0].end(), 1.0);
+         if ((int(max_diversity*100000) != 0) && (min_diversity != max_diversity))
+            for (size_t i = 0; i < n; ++i)
+               stats[1][i] = (diversity_ave[i] - min_diversity) / (max_diversity - min_diversity);
+         else
+            std::fill(stats[1].begin(), stats[1].end(), 1.0);
+
+         // a trait's score depends only on how many of its histories the
+         // genome defects on, so it is looked up by that count
+         using G = Player::Genome;
+         static const auto nice = trait(G::nice_mask, G::cooperation);
+         static const auto forgiving = trait(G::forgiving_mask, G::cooperation);
+         static const auto retaliating = trait(G::retaliating_mask, G::defection);
+         static const auto nonenvious = trait(G::nonenvious_mask, G::cooperation);
+         for (size_t i = 0; i < n; ++i)
          {
-            if (min_sco > first->score_ave)
-               min_sco = first->score_ave;
-            if (min_div > first->diversity_ave)
-               min_div = first->diversity_ave;
-         } 
-      }      
-      Player* get_random_agent()
-      {
-         if (size() < 2) return &*std::begin(agents);
-         return &*(std::begin(agents)+Rand::randn(size()));
+            const G g(genomes[i]);
+            stats[2][i] = nice[g.defections(G::nice_mask)];
+            stats[3][i] = forgiving[g.defections(G::forgiving_mask)];
+            stats[4][i] = retaliating[g.defections(G::retaliating_mask)];
+            stats[5][i] = nonenvious[g.defections(G::nonenvious_mask)];
+         }
+
+         std::fill(fitness.begin(), fitness.end(), 0.0);
+         for (size_t s = 0; s < num_stats; ++s)
+            for (size_t i = 0; i < n; ++i)
+               fitness[i] += stats[s][i]*weights[s];
       }
-      
-      double fitness_mean() const
+
+      void get_range(double& max_sco, double& max_div,
+            double& min_sco, double& min_div) const
       {
-         double sum = 0.0;
-         for (auto a : agents)
-            sum += a.fitness;
-         return sum / double(size());
+         assert(size()!=0);
+         range(score_ave, max_sco, min_sco);
+         range(diversity_ave, max_div, min_div);
       }
-      
-      double fitness_sd(double mean) const
+
+      double fitness_mean() const { return mean(fitness); }
+      double fitness_sd(double mean) const { return sd(fitness, mean); }
+      double score_mean() const { return mean(score_ave); }
+      double score_sd(double mean) const { return sd(score_ave, mean); }
+      double diversity_mean() const { return mean(diversity_ave); }
+      double diversity_sd(double mean) const { return sd(diversity_ave, mean); }
+      double stat_mean(size_t i) const { return mean(stats[i]); }
+
+      size_t size() const { return genomes.size(); }
+
+      friend std::ostream& operator<<(std::ostream& os, Population const& p);
+
+   private:
+      using Trait = std::array<double, 65>;
+
+      static Trait trait(unsigned long long mask, double (*score)(unsigned long long, size_t))
       {
-         double sum = 0.0;
-         for(auto a : agents)
-            sum += (a.fitness - mean) * (a.fitness - mean);
-         return std::sqrt(sum / double(size()));
+         Trait t;
+         for (size_t k = 0; k < t.size(); ++k)
+            t[k] = score(mask, k);
+         return t;
       }
-      
-      double score_mean() const
+
+      template <typename T>
+      static void permute(std::vector<T>& column, std::vector<size_t> const& order)
       {
-         double sum = 0.0;
-         for (auto a : agents)
-            sum += a.score_ave;
-         return sum / double(size());
+         std::vector<T> sorted(column.size());
+         for (size_t i = 0; i < order.size(); ++i)
+            sorted[i] = column[order[i]];
+         column.swap(sorted);
       }
-      
-      double score_sd(double mean) const
+
+      // The column reductions keep one running value per slot of a block
+      // of agents, so, like the lane loops in Batch, the block loops
+      // compile to vector code.
+      static constexpr size_t block = 8;
+
+      static void range(std::vector<double> const& c, double& max, double& min)
       {
-         double sum = 0.0;
-         for(auto a : agents)
-            sum += (a.score_ave - mean) * (a.score_ave - mean);
-         return std::sqrt(sum / double(size()));
+         double hi[block], lo[block];
+         for (size_t k = 0; k < block; ++k)
+            hi[k] = lo[k] = c.front();
+
+         const size_t n = c.size(), body = n - n % block;
+         for (size_t i = 0; i < body; i += block)
+            for (size_t k = 0; k < block; ++k)
+            {
+               hi[k] = c[i + k] > hi[k] ? c[i + k] : hi[k];
+               lo[k] = c[i + k] < lo[k] ? c[i + k] : lo[k];
+            }
+         for (size_t i = body; i < n; ++i)
+         {
+            hi[i - body] = c[i] > hi[i - body] ? c[i] : hi[i - body];
+            lo[i - body] = c[i] < lo[i - body] ? c[i] : lo[i - body];
+         }
+
+         max = hi[0];
+         min = lo[0];
+         for (size_t k = 1; k < block; ++k)
+         {
+            max = std::max(max, hi[k]);
+            min = std::min(min, lo[k]);
+         }
       }
-      
-      double diversity_mean() const
+
+      static double total(double const (&part)[block])
       {
          double sum = 0.0;
-         for (auto a : agents)
-            sum += a.diversity_ave;
-         return sum / double(size());
+         for (size_t k = 0; k < block; ++k)
+            sum += part[k];
+         return sum;
       }
-         
-      double diversity_sd(double mean) const
+
+      static double mean(std::vector<double> const& c)
       {
-         double sum = 0.0;
-         for(auto a : agents)
-            sum += (a.diversity_ave - mean) * (a.diversity_ave - mean);
-         return std::sqrt(sum / double(size()));
+         double part[block] = {};
+         const size_t n = c.size(), body = n - n % block;
+         for (size_t i = 0; i < body; i += block)
+            for (size_t k = 0; k < block; ++k)
+               part[k] += c[i + k];
+         for (size_t i = body; i < n; ++i)
+            part[i - body] += c[i];
+         return total(part) / double(n);
       }
-      
-      double stat_mean(size_t i) const
+
+      static double sd(std::vector<double> const& c, double mean)
       {
-         double sum = 0.0;
-         for (auto a : agents)
-            sum += a.stats[i];
-         return sum / double(size());
+         double part[block] = {};
+         const size_t n = c.size(), body = n - n % block;
+         for (size_t i = 0; i < body; i += block)
+            for (size_t k = 0; k < block; ++k)
+               part[k] += (c[i + k] - mean) * (c[i + k] - mean);
+         for (size_t i = body; i < n; ++i)
+            part[i - body] += (c[i] - mean) * (c[i] - mean);
+         return std::sqrt(total(part) / double(n));
       }
-      
-      size_t size() const { return agents.size(); }
-      
-      friend std::ostream& operator<<(std::ostream& os, Population const& p);
 };
 
 #endif
@@ -1,48 +1,94 @@
 #ifndef _RAND_
 #define _RAND_
 
-#include <bitset>
+#include <cstdint>
 #include <random>
-#include <algorithm>
+#include <utility>
+#include <vector>
 
+// Counter-based random stream. The i-th value of a stream is a pure
+// function of (seed, stream, i), so streams can be handed to threads or
+// islands and any value can be regenerated without replaying the others.
+// Values come from the SplitMix64 finaliser applied to a Weyl sequence.
 class Rand {
     public:
-        static unsigned long rand(float a, float b) { 
-            static std::random_device rd;
-            static std::mt19937 generator(rd());
-            static std::uniform_int_distribution<> distribution(a, b);
-            return distribution(generator);
+        using result_type = uint64_t;
+
+        Rand(uint64_t seed, uint64_t stream = 0)
+            : key(mix(mix(seed) ^ mix(stream + golden))), counter(0) {}
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return ~result_type(0); }
+
+        // independent stream derived from this one
+        Rand split(uint64_t stream) const { return Rand(key, stream); }
+
+        result_type at(uint64_t i) const { return mix(key + (i + 1) * golden); }
+
+        result_type operator()() { return at(counter++); }
+
+        // uniform on [0, n)
+        uint64_t below(uint64_t n) {
+            const uint64_t limit = max() - max() % n;
+            uint64_t r;
+            do r = (*this)(); while (r >= limit);
+            return r % n;
         }
 
-        static unsigned long randBit() { 
-            return rand(0,1); 
+        // uniform on [a, b]
+        uint64_t range(uint64_t a, uint64_t b) {
+            return a + below(b - a + 1);
         }
 
-        static unsigned long randBinN(unsigned int n, double p) {
-            static std::random_device rd; 
-            static std::mt19937 generator(rd());
-            std::binomial_distribution<> distribution(n, p);
-            return distribution(generator);
+        // Counts the successes of n trials one by one. Unlike
+        // std::binomial_distribution this never calls lgamma, which writes
+        // the global signgam, so simulations on several threads can sample
+        // it at once; n is a population size, so the cost is negligible
+        // beside the tournament.
+        uint64_t binomial(uint64_t n, double p) {
+            uint64_t k = 0;
+            for (uint64_t i = 0; i < n; ++i)
+                k += unit() < p;
+            return k;
         }
 
-        static unsigned long randn(unsigned int n) {
-            return rand(0,n-1);
+        std::vector<uint64_t> genomes(size_t n) {
+            std::vector<uint64_t> bits(n);
+            for (auto& b : bits)
+                b = (*this)();
+            return bits;
         }
-        
-        static std::bitset<64> random_64_bits() {
-            std::bitset<64> bits = 0;
-            for (size_t i = 0; i < 64; ++i)
-                bits[i] = randBit();
-            auto retVal = std::move(bits);
-            return retVal;
+
+        std::vector<unsigned> crossover_points(size_t n) {
+            std::vector<unsigned> points(n);
+            for (auto& p : points)
+                p = range(1, 63);
+            return points;
+        }
+
+        // (agent, bit) pairs for n mutations over a population of pop_size
+        std::vector<std::pair<size_t, unsigned>> mutation_sites(size_t n, size_t pop_size) {
+            std::vector<std::pair<size_t, unsigned>> sites(n);
+            for (auto& s : sites) {
+                s.first = below(pop_size);
+                s.second = below(64);
+            }
+            return sites;
         }
 
-        static std::bitset<6> random_6_bits() {
-            std::bitset<6> bits = 0;
-            for (size_t i = 0; i < 6; ++i)
-                bits[i] = randBit();
-            auto retVal = std::move(bits);
-            return retVal;
+    private:
+        // uniform on [0, 1), from the top 53 bits
+        double unit() { return double((*this)() >> 11) / 9007199254740992.0; }
+
+        static constexpr uint64_t golden = 0x9E3779B97F4A7C15ull;
+
+        static uint64_t mix(uint64_t z) {
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
         }
+
+        uint64_t key;
+        uint64_t counter;
 };
 #endif
@@ -0,0 +1,222 @@
+#ifndef _SCORES_
+#define _SCORES_
+
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "player.hxx"
+
+// Game results between the agents of a population, kept from one
+// evaluation to the next. Each agent is given a slot that follows it
+// through sorting (Population::slots); a slot keeps the genome it was scored
+// with, so an agent that is new, mutated or copied in from elsewhere is
+// recognised and rescored. Only games involving such agents are played
+// again, and the per-slot score and diversity sums are updated from the
+// rows that changed.
+//
+// Use: claim() the current agents, then take the games to play a chunk
+// at a time with next(), play them and record() their results, then read
+// the sums back with sums().
+class ScoreMatrix
+{
+   public:
+      using Pair = std::pair<uint32_t, uint32_t>;
+
+      // Memory the stored results of one population may take.
+      static constexpr size_t max_bytes = size_t(1) << 28;
+
+      // Scores are stored in 32 bits, and a result is kept for every pair
+      // of agents, so large populations are scored in full instead.
+      static bool fits(size_t rounds, size_t agents)
+      {
+         return rounds <= std::numeric_limits<uint32_t>::max() / 20
+            && combation_pairs(agents) <= max_bytes / sizeof(Entry);
+      }
+
+      void clear()
+      {
+         entries.clear();
+         genome.clear();
+         live.clear();
+         score_sum.clear();
+         diversity_sum.clear();
+         coop_sum = defect_sum = mixed_sum = 0;
+         dirty.clear();
+         cursor = next_slot = 0;
+      }
+
+      // Assigns slots to agents and works out which games must be played.
+      void claim(std::vector<uint64_t> const& agents, std::vector<size_t>& slots,
+            size_t _rounds)
+      {
+         if (_rounds != rounds) {
+            clear();
+            rounds = _rounds;
+         }
+
+         const size_t used = genome.size();
+         std::vector<char> claimed(used, 0);
+         std::vector<size_t> fresh;
+         for (size_t i = 0; i < agents.size(); ++i)
+         {
+            size_t s = slots[i];
+            if (s < used && live[s] && !claimed[s] && genome[s] == agents[i])
+               claimed[s] = 1;
+            else
+               fresh.push_back(i);
+         }
+
+         // drop the games of slots whose agent is gone
+         for (size_t s = 0; s < used; ++s)
+            if (live[s] && !claimed[s])
+               retract(s);
+
+         // every agent ends up with a slot; size the table for them once
+         // rather than letting it double as slots are added
+         if (agents.size() > genome.size())
+            entries.reserve(combation_pairs(agents.size()));
+
+         dirty.assign(genome.size(), 0);
+         size_t next_free = 0;
+         for (size_t i : fresh)
+         {
+            while (next_free < genome.size() && live[next_free])
+               ++next_free;
+            if (next_free == genome.size())
+               grow();
+
+            size_t s = next_free;
+            slots[i] = s;
+            genome[s] = agents[i];
+            live[s] = 1;
+            score_sum[s] = diversity_sum[s] = 0;
+            dirty.resize(genome.size(), 0);
+            dirty[s] = 1;
+         }
+
+         cursor = next_slot = 0;
+      }
+
+      // genome of each slot; the pairs from next() index into it
+      std::vector<uint64_t> const& genomes() const { return genome; }
+
+      // Fills chunk with up to max of the games still to play, as (lower
+      // slot, higher slot), carrying on from the last call. Returns false
+      // once every game has been handed out.
+      bool next(std::vector<Pair>& chunk, size_t max)
+      {
+         chunk.clear();
+         for (; cursor < genome.size(); ++cursor, next_slot = 0)
+         {
+            const size_t s = cursor;
+            if (!dirty[s])
+               continue;
+            for (; next_slot < genome.size(); ++next_slot)
+            {
+               const size_t t = next_slot;
+               if (t == s || !live[t] || (dirty[t] && t < s))
+                  continue;
+               if (chunk.size() == max)
+                  return true;
+               chunk.emplace_back(std::min(s, t), std::max(s, t));
+            }
+         }
+         return !chunk.empty();
+      }
+
+      // Stores the results of a chunk from next(), in the same order.
+      void record(std::vector<Pair> const& chunk, std::vector<Player::Match> const& results)
+      {
+         for (size_t k = 0; k < chunk.size(); ++k)
+         {
+            size_t s = chunk[k].first, t = chunk[k].second;
+            auto const& m = results[k];
+            entries[index(s, t)] = {uint32_t(m.score_a), uint32_t(m.score_b),
+               uint32_t(m.coop), uint32_t(m.defect)};
+            add(s, t, entries[index(s, t)], 1);
+         }
+      }
+
+      // Per-agent sums and the choice tallies of the whole population.
+      template <typename Tally>
+      void sums(std::vector<size_t> const& slots, Tally& out) const
+      {
+         out.reset(slots.size());
+         for (size_t i = 0; i < slots.size(); ++i)
+         {
+            out.score_sum[i] = score_sum[slots[i]];
+            out.diversity_sum[i] = diversity_sum[slots[i]];
+         }
+         out.coop_sum = coop_sum;
+         out.defect_sum = defect_sum;
+         out.mixed_sum = mixed_sum;
+      }
+
+   private:
+      struct Entry
+      {
+         uint32_t score_lo, score_hi;
+         uint32_t coop, defect;
+      };
+
+      // lower triangle by the higher slot, so adding a slot only appends
+      static size_t index(size_t s, size_t t) { return t * (t - 1) / 2 + s; }
+
+      void grow()
+      {
+         genome.push_back(0);
+         live.push_back(0);
+         score_sum.push_back(0);
+         diversity_sum.push_back(0);
+         entries.resize(combation_pairs(genome.size()));
+      }
+
+      // sign is +1 to add a game to the sums, -1 to take it out
+      void add(size_t s, size_t t, Entry const& e, int sign)
+      {
+         const uint64_t d = std::bitset<64>(genome[s] ^ genome[t]).count();
+         const uint64_t mixed = rounds - e.coop - e.defect;
+         if (sign > 0) {
+            score_sum[s] += e.score_lo;
+            score_sum[t] += e.score_hi;
+            diversity_sum[s] += d;
+            diversity_sum[t] += d;
+            coop_sum += e.coop;
+            defect_sum += e.defect;
+            mixed_sum += mixed;
+         }
+         else {
+            score_sum[s] -= e.score_lo;
+            score_sum[t] -= e.score_hi;
+            diversity_sum[s] -= d;
+            diversity_sum[t] -= d;
+            coop_sum -= e.coop;
+            defect_sum -= e.defect;
+            mixed_sum -= mixed;
+         }
+      }
+
+      void retract(size_t s)
+      {
+         live[s] = 0;
+         for (size_t t = 0; t < genome.size(); ++t)
+            if (live[t])
+               add(std::min(s, t), std::max(s, t), entries[index(std::min(s, t), std::max(s, t))], -1);
+         score_sum[s] = diversity_sum[s] = 0;
+      }
+
+      size_t rounds = 0;
+      std::vector<Entry> entries;
+      std::vector<uint64_t> genome;
+      std::vector<char> live;
+      std::vector<uint64_t> score_sum, diversity_sum;
+      uint64_t coop_sum = 0, defect_sum = 0, mixed_sum = 0;
+      // slots whose games must be played again, and the next() position
+      std::vector<char> dirty;
+      size_t cursor = 0, next_slot = 0;
+};
+
+#endif
@@ -4,12 +4,44 @@
 #include "rand.hxx"
 #include "population.hxx"
 #include "player.hxx"
+#include "tournament.hxx"
+#include "genlog.hxx"
 
 bool fileExists(const std::string& file) {
     struct stat buf;
     return (stat(file.c_str(), &buf) == 0);
 }
 
+// Creates and returns the first free prefixN directory. mkdir is atomic,
+// so concurrent callers never get the same one.
+std::string makeUniqueDir(const std::string& prefix) {
+    for (unsigned long i = 0; ; ++i) {
+        std::string dir = prefix + std::to_string(i);
+        if (mkdir(dir.c_str(), 0777) == 0)
+            return dir;
+        if (errno != EEXIST) {
+            std::cerr << "cannot create " << dir << std::endl;
+            return ".";
+        }
+    }
+}
+
+// Seconds between successive calls to lap().
+class Stopwatch {
+   public:
+      Stopwatch() : last(std::chrono::steady_clock::now()) {}
+      
+      double lap() {
+         auto now = std::chrono::steady_clock::now();
+         double s = std::chrono::duration<double>(now - last).count();
+         last = now;
+         return s;
+      }
+      
+   private:
+      std::chrono::steady_clock::time_point last;
+};
+
 struct Simulation {
       struct Parameters {
          unsigned int pop_size;
@@ -18,36 +50,85 @@ struct Simulation {
          double selection_rate;
          double mutation_rate;
          Statistics weights;
+         size_t num_threads = 1;
+         uint64_t seed = 0;
+         bool quiet = false;
+         bool binary_log = false;
+         bool incremental = true;
+         std::string output_dir;
          
          friend std::ostream& operator<<(std::ostream& os, Simulation::Parameters const& p);
+         friend std::istream& operator>>(std::istream& is, Simulation::Parameters& p);
       };
 
-      Simulation(Parameters _params) : params(_params) {
+      Simulation(Parameters _params)
+         : rng(_params.seed), tournament(_params.num_threads), params(_params) {
          make_csv("demographics", demographics_csv);
-         print_demographics_headings();
+         print_demographics_headings(demographics_csv);
          make_csv("final_population", final_population_file);
-         print_finalpop_headings();
-         make_csv("all_population", all_population_file);
+         print_finalpop_headings(final_population_file);
+         if (params.binary_log)
+            gen_log.reset(new GenerationLog(make_name("generations", ".ipdlog"), log_header()));
+         else
+            make_csv("all_population", all_population_file);
+      }
+      
+      std::string make_name(std::string s, std::string ext) {
+         if (!params.output_dir.empty())
+            s = params.output_dir + "/" + s;
+         while (fileExists(s + std::to_string(file_index) + ext))
+            ++file_index;
+         return s + std::to_string(file_index) + ext;
       }
       
       void make_csv(std::string s, std::ofstream& os) {
-         static unsigned long i = 0;
-         while (fileExists(s + std::to_string(i) + ".csv"))
-            ++i;
-         os.open(s + std::to_string(i) + ".csv",
+         os.open(make_name(s, ".csv"),
             std::ofstream::out | std::ofstream::trunc);
          os << params;
       }
       
+      LogHeader log_header() const {
+         LogHeader h;
+         std::copy(LogHeader::expected_magic(), LogHeader::expected_magic() + sizeof h.magic, h.magic);
+         h.version = LogHeader::current_version;
+         h.num_stats = params.weights.size();
+         h.pop_size = params.pop_size;
+         h.num_genetic_iter = params.num_genetic_iter;
+         h.num_compete_iter = params.num_compete_iter;
+         h.seed = params.seed;
+         h.selection_rate = params.selection_rate;
+         h.mutation_rate = params.mutation_rate;
+         h.weights = params.weights;
+         return h;
+      }
+      
+      static Parameters parameters(LogHeader const& h) {
+         Parameters p;
+         p.pop_size = h.pop_size;
+         p.num_genetic_iter = h.num_genetic_iter;
+         p.num_compete_iter = h.num_compete_iter;
+         p.seed = h.seed;
+         p.selection_rate = h.selection_rate;
+         p.mutation_rate = h.mutation_rate;
+         p.weights = h.weights;
+         return p;
+      }
+      
       ~Simulation() {
+         gen_log.reset();
          demographics_csv.close();
          final_population_file.close();
          all_population_file.close();
       }
       
-      void print_demographics_headings() {
-         demographics_csv
-            << std::endl
+      static void print_demographics_headings(std::ostream& os) {
+         os << std::endl;
+         print_demographics_columns(os);
+         os << std::endl;
+      }
+      
+      static void print_demographics_columns(std::ostream& os) {
+         os
             << "Generation, Selected, "
             << "Fitness Mean, Fitness SD, "
             << "Score Mean, Score SD, "
@@ -55,41 +136,104 @@ struct Simulation {
             << "Relative Score Mean, Relative Diversity Mean, "
             << "Niceness Mean, Forgiveness Mean, "
             << "Retaliation Mean, Non-Envy Mean, "
-            << "All-Coop Prop, All-Defect Prop, Mixed Prop"
-            << std::endl
+            << "All-Coop Prop, All-Defect Prop, Mixed Prop, "
+            << "Evaluate Time, Breed Time, Log Time, "
+            << "Games Played, Rounds per Second, Bytes Logged"
             ;
       }
       
-      void log_demographics(size_t i, Population const& p) {
+      Demographics demographics(size_t i, Population const& p) const {
+         Demographics d;
+         d.generation = i;
+         d.selected = num_selected;
+         d.fitness_mean = p.fitness_mean();
+         d.fitness_sd = p.fitness_sd(d.fitness_mean);
+         d.score_mean = p.score_mean();
+         d.score_sd = p.score_sd(d.score_mean);
+         d.diversity_mean = p.diversity_mean();
+         d.diversity_sd = p.diversity_sd(d.diversity_mean);
+         for (size_t a = 0; a < params.weights.size(); ++a)
+            d.stat_means[a] = p.stat_mean(a);
+         d.coop_prop = coop_prop;
+         d.defect_prop = defect_prop;
+         d.mixed_prop = mixed_prop;
+         return d;
+      }
+      
+      static void print_demographics(std::ostream& os, Demographics const& d) {
          //iterations number
-         demographics_csv
-            << i << ", " << num_selected << ", ";
-            
-         double tmp; 
+         os << d.generation << ", " << d.selected << ", "
+            << d.fitness_mean << ", " << d.fitness_sd << ", "
+            << d.score_mean << ", " << d.score_sd << ", "
+            << d.diversity_mean << ", " << d.diversity_sd;
          
-         tmp = p.fitness_mean();
-         demographics_csv
-            << tmp << ", " << p.fitness_sd(tmp) << ", ";
-            
-         tmp = p.score_mean();
-         demographics_csv
-            << tmp << ", " << p.score_sd(tmp) << ", ";
-            
-         tmp = p.diversity_mean();
-         demographics_csv
-            << tmp << ", " << p.diversity_sd(tmp);
-            
-         for (size_t a = 0; a < params.weights.size(); ++a)
-            demographics_csv << ", " << p.stat_mean(a);
+         for (auto const& m : d.stat_means)
+            os << ", " << m;
          
-         demographics_csv << ", "
-            << coop_prop << ", "
-            << defect_prop << ", "
-            << mixed_prop << std::endl;
+         os << ", "
+            << d.coop_prop << ", "
+            << d.defect_prop << ", "
+            << d.mixed_prop << ", "
+            << d.evaluate_seconds << ", "
+            << d.breed_seconds << ", "
+            << d.log_seconds << ", "
+            << d.games << ", "
+            << d.rounds_per_second << ", "
+            << d.bytes_logged << '\n';
       }
       
-      void print_finalpop_headings() {
-         final_population_file
+      void log_demographics(Demographics const& d) {
+         print_demographics(demographics_csv, d);
+         if (gen_log)
+            gen_log->demographics(d);
+      }
+      
+      // bytes written to the logs so far
+      uint64_t bytes_logged() {
+         uint64_t n = 0;
+         if (demographics_csv.is_open())
+            n += demographics_csv.tellp();
+         if (final_population_file.is_open())
+            n += final_population_file.tellp();
+         if (all_population_file.is_open())
+            n += all_population_file.tellp();
+         if (gen_log)
+            n += gen_log->bytes();
+         return n;
+      }
+      
+      // Sets d.bytes_logged to `other` plus the size of d's own
+      // demographics records. The text row's length depends on the
+      // number it carries, so this repeats until the two agree; the
+      // digit count can only grow, so it settles within a few passes.
+      void count_bytes_logged(Demographics& d, uint64_t other) const {
+         d.bytes_logged = other;
+         for (;;)
+         {
+            std::ostringstream row;
+            print_demographics(row, d);
+            uint64_t n = other + row.str().size();
+            if (gen_log)
+               n += GenerationLog::demographics_size();
+            if (n == d.bytes_logged)
+               return;
+            d.bytes_logged = n;
+         }
+      }
+      
+      // demographics of the most recent generation
+      Demographics const& last_demographics() const { return latest; }
+      
+      // agents that replace_worst moved in this generation
+      size_t selected() const { return num_selected; }
+      
+      // called at the end of every generation with the surviving population
+      void on_generation(std::function<void(size_t, Population&)> hook) {
+         generation_hook = std::move(hook);
+      }
+      
+      static void print_finalpop_headings(std::ostream& os) {
+         os
             << std::endl
             << "Rank, Strategy, Fitness, Average Score, Average Diversity, "
             << "Relative Average Score, Relative Average Diversity, "
@@ -97,49 +241,72 @@ struct Simulation {
             << std::endl;
       }
       
-      void log_finalpop(Population const& p) {
-         size_t rank = 0;
-         for (auto const& a : p.agents)
+      static void print_finalpop(std::ostream& os, Population const& p) {
+         for (size_t i = 0; i < p.size(); ++i)
          {
-            final_population_file
-               << ++rank << ", "
-               << a.genome << ", "
-               << a.fitness << ", "
-               << a.score_ave << ", "
-               << a.diversity_ave;
-            for (auto const& b : a.stats)
-               final_population_file << ", " << b;
-            final_population_file << std::endl;
+            os
+               << i + 1 << ", "
+               << p.genome(i) << ", "
+               << p.fitness[i] << ", "
+               << p.score_ave[i] << ", "
+               << p.diversity_ave[i];
+            for (auto const& b : p.stats)
+               os << ", " << b[i];
+            os << '\n';
          }
       }
       
-      void evaluate(Population &p)
+      void log_finalpop(size_t i, Population const& p) {
+         print_finalpop(final_population_file, p);
+         if (gen_log)
+            gen_log->population(RecordHeader::Final, i, p);
+      }
+      
+      void log_population(RecordHeader::Kind kind, size_t i, Population const& p) {
+         if (!params.quiet)
+            std::cout << p;
+         if (gen_log)
+            gen_log->population(kind, i, p);
+         else
+            all_population_file << p << '\n';
+      }
+      
+      // With reuse, games already played between surviving agents are
+      // taken from p.scores and only those involving new agents are played.
+      void evaluate(Population &p, bool reuse = false)
       {
-         for (auto& a : p.agents)
-            a.clear_sums();
-         
          clear_choice_tally();
          
-         for(auto A = std::begin(p.agents); A != std::end(p.agents); ++A) {
-            for(auto B = next(A); B != std::end(p.agents); ++B) {
-               Player::PastGenes pm;
-               for (size_t i = 0; i < params.num_compete_iter; ++i)
-                  tally_choice(Player::compete(*A,*B,pm));
-               Player::diversity(*A,*B);
+         if (reuse && ScoreMatrix::fits(params.num_compete_iter, p.size())) {
+            p.scores.claim(p.genomes, p.slots, params.num_compete_iter);
+            const Rand games = rng.split(rng());
+            size_t played = 0;
+            while (p.scores.next(chunk, chunk_games)) {
+               tournament.play_pairs(p.scores.genomes(), chunk,
+                  params.num_compete_iter, games, played, matches);
+               p.scores.record(chunk, matches);
+               played += chunk.size();
             }
+            games_played += played;
+            p.scores.sums(p.slots, tally);
+         }
+         else {
+            tournament.play(p, params.num_compete_iter, rng.split(rng()), tally);
+            games_played += combation_pairs(p.size());
          }
+         coop_sum = tally.coop_sum;
+         defect_sum = tally.defect_sum;
+         mixed_sum = tally.mixed_sum;
          
          calc_choice_prop();
          
-         for (auto& a : p.agents)
-            a.calc_aves(params.pop_size, params.num_compete_iter);
+         p.calc_aves(tally.score_sum, tally.diversity_sum,
+            params.pop_size, params.num_compete_iter);
          
          double max_sco, max_div, min_sco, min_div;
-         p.get_max(max_sco, max_div);
-         p.get_min(min_sco, min_div);
+         p.get_range(max_sco, max_div, min_sco, min_div);
          
-         for (auto& a : p.agents)
-            a.calc_fitness(params.weights, max_sco, max_div, min_sco, min_div);
+         p.calc_fitness(params.weights, max_sco, max_div, min_sco, min_div);
          
          p.sort();
       }
@@ -171,10 +338,10 @@ struct Simulation {
       
       Population select_best(Population const& a)
       {
-         Population b(0);
+         Population b;
          
          for (size_t i = 0; i < num_selected; ++i)
-            b.agents.emplace_back(a.agents[i].genome);
+            b.add(a.genomes[i]);
          
          auto retVal = std::move(b);
          return retVal;
@@ -183,12 +350,15 @@ struct Simulation {
       Population recombine(Population const& p)
       {
          Population parents(select_best(p));
-         Population children(0);
-         for(auto A = std::begin(parents.agents); A != std::end(parents.agents); ++A) {
-            for(auto B = next(A); B != std::end(parents.agents); ++B) {
+         Population children;
+         auto cpoints = rng.crossover_points(
+            std::min<size_t>(params.pop_size, combation_pairs(parents.size())));
+         for(size_t A = 0; A < parents.size(); ++A) {
+            for(size_t B = A + 1; B < parents.size(); ++B) {
                if (children.size() < params.pop_size)
-                  children.agents.emplace_back(
-                     Player::Genome::crossover(A->genome,B->genome));
+                  children.add(
+                     Player::Genome::crossover(parents.genome(A),parents.genome(B),
+                        cpoints[children.size()]).bits());
                else  {
                    auto retVal = std::move(children);
                    return retVal;
@@ -201,8 +371,13 @@ struct Simulation {
       
       void mutate(Population& p)
       {
-         for (size_t i = 0; i < floor(p.size()*params.mutation_rate); ++i)
-            p.get_random_agent()->genome.mutate();
+         size_t n = floor(p.size()*params.mutation_rate);
+         for (auto const& site : rng.mutation_sites(n, p.size()))
+         {
+            Player::Genome g = p.genome(site.first);
+            g.mutate(site.second);
+            p.genomes[site.first] = g.bits();
+         }
       }
       
       void replace_worst(Population &dest, Population& source)
@@ -212,53 +387,97 @@ struct Simulation {
          assert(dest.size() >= next.size());
          
          assert(num_selected == next.size());
-         for (size_t i=0; i < num_selected; ++i)
-            dest.agents.pop_back();
+         dest.truncate(dest.size() - num_selected);
          
-         for (auto& best : next.agents)
-            dest.agents.emplace_back(best);
+         for (auto best : next.genomes)
+            dest.add(best);
       }
       
       void genetic()
       {
-         Population initial(params.pop_size);
+         Population initial(params.pop_size, rng);
             
          for (size_t i=0; i < params.num_genetic_iter; ++i)
          {
-            std::cout << "                              " << std::endl;
-            std::cout << "         ITERATION # " << i << "            " << std::endl;
+            Stopwatch clock;
+            double evaluate_time = 0, breed_time = 0, log_time = 0;
+            const uint64_t logged = bytes_logged();
+            games_played = 0;
+            
+            if (!params.quiet)
+               std::cout << "                              " << '\n'
+                  << "         ITERATION # " << i << "            " << '\n';
             
-            evaluate(initial);
+            evaluate(initial, params.incremental);
+            evaluate_time += clock.lap();
          
-            num_selected = Rand::randBinN(initial.size(),params.selection_rate);
+            num_selected = rng.binomial(initial.size(),params.selection_rate);
          
-            log_demographics(i, initial);
+            latest = demographics(i, initial);
             
-            std::cout << "       Initial Population      " << std::endl;
-            std::cout << initial;
-            all_population_file << initial << std::endl;
+            if (!params.quiet)
+               std::cout << "       Initial Population      " << '\n';
+            log_population(RecordHeader::Initial, i, initial);
+            log_time += clock.lap();
             
             Population next = recombine(initial);
             mutate(next);
+            breed_time += clock.lap();
             evaluate(next);
+            evaluate_time += clock.lap();
             
-            num_selected = Rand::randBinN(next.size(),params.selection_rate);
+            num_selected = rng.binomial(next.size(),params.selection_rate);
             
-            std::cout << "********** Next Population **********" << std::endl;
-            std::cout << next;
-            all_population_file << next << std::endl;
+            if (!params.quiet)
+               std::cout << "********** Next Population **********" << '\n';
+            log_population(RecordHeader::Next, i, next);
+            log_time += clock.lap();
             
             replace_worst(initial, next);
+            breed_time += clock.lap();
+            
+            //log the final population to a file, counted with the last generation
+            if (i + 1 == params.num_genetic_iter) {
+               log_finalpop(params.num_genetic_iter, initial);
+               log_time += clock.lap();
+            }
+            
+            latest.evaluate_seconds = evaluate_time;
+            latest.breed_seconds = breed_time;
+            latest.log_seconds = log_time;
+            latest.games = games_played;
+            latest.rounds_per_second = evaluate_time > 0
+               ? games_played * double(params.num_compete_iter) / evaluate_time : 0;
+            count_bytes_logged(latest, bytes_logged() - logged);
+            log_demographics(latest);
+            if (gen_log)
+               gen_log->commit();
+            
+            if (generation_hook)
+               generation_hook(i, initial);
          }
          
-         std::cout << std::endl << std::endl;
+         if (!params.quiet)
+            std::cout << std::endl << std::endl;
          
-         //log the final population to a file
-         log_finalpop(initial);
+         if (params.num_genetic_iter == 0)
+            log_finalpop(0, initial);
       }
       
    private:
       std::ofstream demographics_csv, final_population_file, all_population_file;
+      std::unique_ptr<GenerationLog> gen_log;
+      unsigned long file_index = 0;
+      Demographics latest{};
+      std::function<void(size_t, Population&)> generation_hook;
+      Rand rng;
+      Tournament tournament;
+      Tournament::Tally tally;
+      // games played and recorded at a time when reusing results
+      static constexpr size_t chunk_games = size_t(1) << 16;
+      std::vector<ScoreMatrix::Pair> chunk;
+      std::vector<Player::Match> matches;
+      uint64_t games_played = 0;
       unsigned long defect_sum, coop_sum, mixed_sum;
       size_t num_selected;
       double defect_prop, coop_prop, mixed_prop;
@@ -0,0 +1,231 @@
+#ifndef _SWEEP_
+#define _SWEEP_
+
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+#include "rand.hxx"
+#include "simulation.hxx"
+
+// Runs a set of independent jobs on a fixed number of threads. Jobs are
+// dealt out round-robin to per-thread deques; a thread works from the
+// back of its own deque and, once that is empty, steals from the front
+// of the others.
+class StealingPool
+{
+   public:
+      using Job = std::function<void()>;
+
+      StealingPool(size_t n_threads) : queues(std::max<size_t>(n_threads, 1)) {}
+
+      void push(Job job)
+      {
+         Queue& q = queues[pushed++ % queues.size()];
+         std::lock_guard<std::mutex> lock(q.mtx);
+         q.jobs.push_back(std::move(job));
+      }
+
+      // Runs every queued job and returns when all have finished.
+      void run()
+      {
+         std::vector<std::thread> threads;
+         for (size_t id = 1; id < queues.size(); ++id)
+            threads.emplace_back(&StealingPool::work, this, id);
+         work(0);
+         for (auto& t : threads)
+            t.join();
+      }
+
+   private:
+      struct Queue
+      {
+         std::mutex mtx;
+         std::deque<Job> jobs;
+      };
+
+      void work(size_t id)
+      {
+         Job job;
+         while (take(id, job))
+            job();
+      }
+
+      bool take(size_t id, Job& job)
+      {
+         {
+            Queue& own = queues[id];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            if (!own.jobs.empty()) {
+               job = std::move(own.jobs.back());
+               own.jobs.pop_back();
+               return true;
+            }
+         }
+         for (size_t k = 1; k < queues.size(); ++k)
+         {
+            Queue& victim = queues[(id + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if (!victim.jobs.empty()) {
+               job = std::move(victim.jobs.front());
+               victim.jobs.pop_front();
+               return true;
+            }
+         }
+         // nothing is queued while running, so an empty sweep means done
+         return false;
+      }
+
+      std::vector<Queue> queues;
+      size_t pushed = 0;
+};
+
+// Parameter sweep: every record read from the input may give a comma
+// separated list of values for any field, and expands to the grid of all
+// combinations. Each run gets its own directory under sweepN/ and a seed
+// derived from the sweep seed, and the last generation's demographics of
+// every run are collected in sweepN/summary.csv.
+struct Sweep
+{
+      static constexpr size_t num_fields = 5 + std::tuple_size<Statistics>::value;
+
+      // Expands the records in is into one Parameters per grid point;
+      // settings not read from the record are taken from base. Returns
+      // false, with runs empty, if any grid point does not parse or the
+      // input ends part way through a record, so that a sweep is run
+      // whole or not at all.
+      static bool expand(std::istream& is, Simulation::Parameters const& base,
+            std::vector<Simulation::Parameters>& runs)
+      {
+         runs.clear();
+         std::vector<std::vector<std::string>> fields(num_fields);
+         for (;;)
+         {
+            for (size_t i = 0; i < num_fields; ++i)
+            {
+               std::string token;
+               if (!(is >> token)) {
+                  if (i == 0)
+                     return true;
+                  std::cerr << "sweep: input ends part way through a record" << std::endl;
+                  runs.clear();
+                  return false;
+               }
+               fields[i] = split(token);
+            }
+
+            std::vector<size_t> pick(num_fields, 0);
+            for (;;)
+            {
+               std::istringstream record;
+               std::string line;
+               for (size_t i = 0; i < num_fields; ++i)
+                  line += fields[i][pick[i]] + " ";
+               record.str(line);
+
+               Simulation::Parameters p(base);
+               std::string extra;
+               if (!(record >> p) || record >> extra) {
+                  std::cerr << "sweep: bad record: " << line << std::endl;
+                  runs.clear();
+                  return false;
+               }
+               runs.push_back(p);
+
+               size_t i = num_fields;
+               while (i > 0 && ++pick[i-1] == fields[i-1].size())
+                  pick[--i] = 0;
+               if (i == 0)
+                  break;
+            }
+         }
+      }
+
+      Sweep(std::vector<Simulation::Parameters> _runs, size_t _jobs, uint64_t _seed)
+         : runs(std::move(_runs)), jobs(_jobs), seed(_seed), results(runs.size()) {}
+
+      // Runs the sweep; returns the directory it was written to.
+      std::string run()
+      {
+         std::string dir = makeUniqueDir("sweep");
+         Rand seeds(seed);
+
+         StealingPool pool(jobs);
+         for (size_t j = 0; j < runs.size(); ++j)
+         {
+            Simulation::Parameters& p = runs[j];
+            p.seed = seeds.at(j);
+            p.quiet = true;
+            p.output_dir = dir + "/run" + std::to_string(j);
+            mkdir(p.output_dir.c_str(), 0777);
+
+            pool.push([this, j] {
+               Simulation sim(runs[j]);
+               sim.genetic();
+               results[j] = sim.last_demographics();
+            });
+         }
+         pool.run();
+
+         std::ofstream summary(dir + "/summary.csv");
+         summary << "Sweep Seed, " << seed << std::endl << std::endl;
+         print_summary_headings(summary);
+         for (size_t j = 0; j < runs.size(); ++j)
+            print_summary(summary, j);
+         return dir;
+      }
+
+   private:
+      static std::vector<std::string> split(std::string const& token)
+      {
+         std::vector<std::string> values;
+         std::istringstream ss(token);
+         std::string v;
+         while (std::getline(ss, v, ','))
+            if (!v.empty())
+               values.push_back(v);
+         if (values.empty())
+            values.push_back(token);
+         return values;
+      }
+
+      void print_summary_headings(std::ostream& os)
+      {
+         os << "Run, Population Size, GA Iterations, Rounds per game, "
+            << "Selection Rate, Mutation Rate, Seed";
+         for (size_t w = 0; w < std::tuple_size<Statistics>::value; ++w)
+            os << ", Weight " << w;
+         os << ", ";
+         Simulation::print_demographics_columns(os);
+         os << std::endl;
+      }
+
+      void print_summary(std::ostream& os, size_t j)
+      {
+         auto const& p = runs[j];
+         os << j << ", "
+            << p.pop_size << ", "
+            << p.num_genetic_iter << ", "
+            << p.num_compete_iter << ", "
+            << p.selection_rate << ", "
+            << p.mutation_rate << ", "
+            << p.seed;
+         for (auto const& w : p.weights)
+            os << ", " << w;
+         os << ", ";
+         Simulation::print_demographics(os, results[j]);
+      }
+
+      std::vector<Simulation::Parameters> runs;
+      size_t jobs;
+      uint64_t seed;
+      std::vector<Demographics> results;
+};
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef _TOURNAMENT_
+#define _TOURNAMENT_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rand.hxx"
+#include "player.hxx"
+#include "population.hxx"
+#include "batch.hxx"
+
+// Round-robin tournament played by a fixed pool of worker threads.
+// The pair triangle is cut into tiles holding an equal number of games;
+// each thread accumulates into its own Tally and the tallies are reduced
+// in thread order, so the result is identical to the serial nested loop.
+// Games within a tile are played Batch::lanes at a time.
+class Tournament
+{
+   public:
+      struct Tally
+      {
+         std::vector<unsigned long> score_sum, diversity_sum;
+         unsigned long coop_sum, defect_sum, mixed_sum;
+
+         void reset(size_t n)
+         {
+            score_sum.assign(n, 0);
+            diversity_sum.assign(n, 0);
+            coop_sum = defect_sum = mixed_sum = 0;
+         }
+
+         void merge(Tally const& t)
+         {
+            for (size_t i = 0; i < score_sum.size(); ++i)
+            {
+               score_sum[i] += t.score_sum[i];
+               diversity_sum[i] += t.diversity_sum[i];
+            }
+            coop_sum += t.coop_sum;
+            defect_sum += t.defect_sum;
+            mixed_sum += t.mixed_sum;
+         }
+      };
+
+      Tournament(size_t n_threads)
+         : local(std::max<size_t>(n_threads, 1)), batches(local.size())
+      {
+         // the calling thread acts as worker 0
+         for (size_t id = 1; id < local.size(); ++id)
+            workers.emplace_back(&Tournament::worker_loop, this, id);
+      }
+
+      Tournament(Tournament const&) = delete;
+      Tournament& operator=(Tournament const&) = delete;
+
+      ~Tournament()
+      {
+         {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+         }
+         wake.notify_all();
+         for (auto& w : workers)
+            w.join();
+      }
+
+      size_t threads() const { return local.size(); }
+
+      // The starting history of pair k is the k-th value of games, so the
+      // outcome does not depend on how the pairs are split among threads.
+      void play(Population const& p, size_t rounds, Rand const& games, Tally& out)
+      {
+         const size_t n = p.size();
+         const size_t pairs = combation_pairs(n);
+
+         for (auto& t : local)
+            t.reset(n);
+
+         const size_t n_tiles = std::min(pairs, threads() * tiles_per_thread);
+
+         run(n_tiles, [&](size_t id, size_t tile) {
+            Tally& t = local[id];
+            size_t k = tile * pairs / n_tiles;
+            const size_t end = (tile + 1) * pairs / n_tiles;
+
+            // unrank the first pair of the tile
+            size_t a = 0, row = n - 1;
+            size_t skip = k;
+            while (skip >= row)
+            {
+               skip -= row;
+               ++a;
+               --row;
+            }
+            size_t b = a + 1 + skip;
+
+            Batch& batch = batches[id];
+            size_t pair_a[Batch::lanes], pair_b[Batch::lanes];
+            size_t used = 0;
+
+            auto flush = [&]() {
+               // idle lanes play a harmless dummy game that is never read
+               for (size_t l = used; l < Batch::lanes; ++l)
+                  batch.genome_a[l] = batch.genome_b[l] = batch.history[l] = 0;
+               batch.play(rounds);
+
+               for (size_t l = 0; l < used; ++l)
+               {
+                  auto const& m = batch.result[l];
+                  auto d = Player::Genome::countUniqueBits(
+                     p.genome(pair_a[l]), p.genome(pair_b[l]));
+
+                  t.score_sum[pair_a[l]] += m.score_a;
+                  t.score_sum[pair_b[l]] += m.score_b;
+                  t.diversity_sum[pair_a[l]] += d;
+                  t.diversity_sum[pair_b[l]] += d;
+                  t.coop_sum += m.coop;
+                  t.defect_sum += m.defect;
+                  t.mixed_sum += m.mixed;
+               }
+               used = 0;
+            };
+
+            for (; k < end; ++k)
+            {
+               pair_a[used] = a;
+               pair_b[used] = b;
+               batch.genome_a[used] = p.genomes[a];
+               batch.genome_b[used] = p.genomes[b];
+               batch.history[used] = games.at(k) & (Batch::states - 1);
+               if (++used == Batch::lanes)
+                  flush();
+
+               if (++b == n)
+               {
+                  ++a;
+                  b = a + 1;
+               }
+            }
+            if (used != 0)
+               flush();
+         });
+
+         out.reset(n);
+         for (auto const& t : local)
+            out.merge(t);
+      }
+
+      // Plays the listed pairs of genomes; results[k] is the game of
+      // pairs[k], which starts from history games.at(first + k).
+      template <typename Pair>
+      void play_pairs(std::vector<uint64_t> const& genomes, std::vector<Pair> const& pairs,
+            size_t rounds, Rand const& games, size_t first, std::vector<Player::Match>& results)
+      {
+         results.resize(pairs.size());
+         const size_t n_tiles = std::min(
+            (pairs.size() + Batch::lanes - 1) / Batch::lanes, threads() * tiles_per_thread);
+
+         run(n_tiles, [&](size_t id, size_t tile) {
+            Batch& batch = batches[id];
+            const size_t begin = tile * pairs.size() / n_tiles;
+            const size_t end = (tile + 1) * pairs.size() / n_tiles;
+
+            for (size_t k = begin; k < end; k += Batch::lanes)
+            {
+               const size_t used = std::min(end - k, size_t(Batch::lanes));
+               for (size_t l = 0; l < Batch::lanes; ++l)
+               {
+                  bool on = l < used;
+                  batch.genome_a[l] = on ? genomes[pairs[k + l].first] : 0;
+                  batch.genome_b[l] = on ? genomes[pairs[k + l].second] : 0;
+                  batch.history[l] = on ? games.at(first + k + l) & (Batch::states - 1) : 0;
+               }
+               batch.play(rounds);
+               std::copy(batch.result, batch.result + used, results.begin() + k);
+            }
+         });
+      }
+
+   private:
+      using Job = std::function<void(size_t, size_t)>;
+
+      static constexpr size_t tiles_per_thread = 8;
+
+      void run(size_t n_tiles, Job const& job)
+      {
+         if (workers.empty())
+         {
+            for (size_t t = 0; t < n_tiles; ++t)
+               job(0, t);
+            return;
+         }
+
+         {
+            std::lock_guard<std::mutex> lock(mtx);
+            current = &job;
+            tiles = n_tiles;
+            next_tile = 0;
+            busy = workers.size();
+            ++generation;
+         }
+         wake.notify_all();
+
+         drain(0);
+
+         std::unique_lock<std::mutex> lock(mtx);
+         done.wait(lock, [this] { return busy == 0; });
+         current = nullptr;
+      }
+
+      void drain(size_t id)
+      {
+         for (size_t t; (t = next_tile++) < tiles; )
+            (*current)(id, t);
+      }
+
+      void worker_loop(size_t id)
+      {
+         size_t seen = 0;
+         for (;;)
+         {
+            {
+               std::unique_lock<std::mutex> lock(mtx);
+               wake.wait(lock, [&] { return stop || generation != seen; });
+               if (stop)
+                  return;
+               seen = generation;
+            }
+
+            drain(id);
+
+            {
+               std::lock_guard<std::mutex> lock(mtx);
+               if (--busy == 0)
+                  done.notify_one();
+            }
+         }
+      }
+
+      std::vector<Tally> local;
+      std::vector<Batch> batches;
+      std::vector<std::thread> workers;
+
+      std::mutex mtx;
+      std::condition_variable wake, done;
+      Job const* current = nullptr;
+      size_t tiles = 0;
+      std::atomic<size_t> next_tile{0};
+      size_t busy = 0;
+      size_t generation = 0;
+      bool stop = false;
+};
+
+#endif